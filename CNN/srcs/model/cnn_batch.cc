@@ -0,0 +1,304 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include "cnn_model.h"
+
+// cnn_batch <N> <input> <output> [--threads=T] [--band=R] [--check] [--scalar]
+//
+// Runs the dut's conv/pool pipeline over many N x N images.  <input> is a
+// directory of input DRAM files named *.in, as cnn_ref gen writes them, or
+// one packed file of input DRAM images back to back.  Each image's output
+// DRAM goes to <output>/<name>.out in the first case and back to back in
+// the packed file <output> in the second.
+//
+// Images are cut into bands of R pooled rows (default: the whole image),
+// and a pool of T workers (default: one per core) takes bands in turn.  A
+// worker reads each band's image rows straight from the file into a 4-row
+// line buffer, so it holds O(N) bytes whatever N and the batch size; a
+// band rereads the 3 or 4 image rows it shares with the band above.
+// --check recomputes every image whole with cnn_run and compares.
+
+struct batch_image {
+    std::string in_path, out_path;
+    off_t in_off, out_off;      // of the image in its file
+};
+
+struct batch_job {
+    int n;
+    bool packed;
+    int in_fd, out_fd;          // the packed files
+    std::vector<batch_image> images;
+    int band, bands;            // pooled rows per band, bands per image
+    std::atomic<size_t> next;
+    std::atomic<bool> failed;
+};
+
+struct band_io {
+    int n, in_fd, out_fd;
+    off_t in_off, out_off;
+};
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static bool pread_all(int fd, void *buf, size_t size, off_t off) {
+    while (size) {
+        ssize_t got = pread(fd, buf, size, off);
+        if (got <= 0) return false;
+        buf = (uint8_t *)buf + got;
+        size -= got;
+        off += got;
+    }
+    return true;
+}
+
+static bool pwrite_all(int fd, const void *buf, size_t size, off_t off) {
+    while (size) {
+        ssize_t put = pwrite(fd, buf, size, off);
+        if (put <= 0) return false;
+        buf = (const uint8_t *)buf + put;
+        size -= put;
+        off += put;
+    }
+    return true;
+}
+
+static bool read_image_row(void *ctx, int r, uint8_t *dram_row) {
+    band_io *io = (band_io *)ctx;
+    return pread_all(io->in_fd, dram_row, io->n, io->in_off + CNN_IMAGE_BASE + (off_t)r * io->n);
+}
+
+static bool write_pool_row(void *ctx, int k, const uint8_t *out_row) {
+    band_io *io = (band_io *)ctx;
+    size_t row_bytes = cnn_out_row_bytes(io->n);
+    return pwrite_all(io->out_fd, out_row, row_bytes, io->out_off + (off_t)k * row_bytes);
+}
+
+static void batch_worker(batch_job *job) {
+    int n = job->n, pool_dim = cnn_pool_dim(n);
+    cnn_line_buffer lb;
+    lb.n = 0;
+    int8_t filt[16];
+    uint8_t filt_dram[CNN_FILTER_BYTES];
+    for (;;) {
+        size_t i = job->next.fetch_add(1);
+        if (i >= job->images.size() * job->bands || job->failed) return;
+        const batch_image &img = job->images[i / job->bands];
+        int k0 = (int)(i % job->bands) * job->band;
+        int k1 = std::min(k0 + job->band, pool_dim);
+
+        band_io io = { n, job->in_fd, job->out_fd, img.in_off, img.out_off };
+        if (!job->packed) {
+            io.in_fd = open(img.in_path.c_str(), O_RDONLY);
+            io.out_fd = open(img.out_path.c_str(), O_WRONLY);
+        }
+        bool ok = io.in_fd >= 0 && io.out_fd >= 0 && pread_all(io.in_fd, filt_dram, CNN_FILTER_BYTES, io.in_off);
+        if (ok) {
+            cnn_unpack_filter(filt_dram, filt);
+            if (lb.n != n) cnn_line_buffer_init(&lb, n, filt);
+            else memcpy(lb.filt, filt, 16);
+            ok = cnn_run_band(&lb, k0, k1, read_image_row, write_pool_row, &io);
+        }
+        if (!job->packed) {
+            if (io.in_fd >= 0) close(io.in_fd);
+            if (io.out_fd >= 0) close(io.out_fd);
+        }
+        if (!ok) {
+            fprintf(stderr, "Error: Unable to process rows %d-%d of %s\n", k0, k1 - 1,
+                    job->packed ? "the packed input" : img.in_path.c_str());
+            job->failed = true;
+            return;
+        }
+    }
+}
+
+// The output file, created at its full size so bands can fill it in any order.
+static int create_output(const char *path, off_t size) {
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return -1;
+    if (ftruncate(fd, size) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static bool list_images(const char *in_dir, const char *out_dir, std::vector<batch_image> &images) {
+    DIR *dir = opendir(in_dir);
+    if (dir == NULL) return false;
+    std::vector<std::string> names;
+    while (struct dirent *e = readdir(dir)) {
+        size_t len = strlen(e->d_name);
+        if (len > 3 && strcmp(e->d_name + len - 3, ".in") == 0) names.push_back(std::string(e->d_name, len - 3));
+    }
+    closedir(dir);
+    // numeric names, as cnn_ref gen writes them, in numeric order
+    std::sort(names.begin(), names.end(), [](const std::string &a, const std::string &b) {
+        return a.size() != b.size() ? a.size() < b.size() : a < b;
+    });
+    for (const std::string &name : names) {
+        batch_image img;
+        img.in_path = std::string(in_dir) + "/" + name + ".in";
+        img.out_path = std::string(out_dir) + "/" + name + ".out";
+        img.in_off = img.out_off = 0;
+        images.push_back(img);
+    }
+    return true;
+}
+
+static bool check_image(int n, int in_fd, off_t in_off, int out_fd, off_t out_off, std::vector<uint8_t> &input,
+                        std::vector<uint8_t> &output, std::vector<uint8_t> &expected) {
+    input.resize(cnn_input_bytes(n));
+    output.resize(cnn_output_bytes(n));
+    expected.resize(cnn_output_bytes(n));
+    if (!pread_all(in_fd, input.data(), input.size(), in_off) || !pread_all(out_fd, output.data(), output.size(), out_off))
+        return false;
+    cnn_run(input.data(), n, expected.data());
+    return output == expected;
+}
+
+static int usage(const char *prog) {
+    fprintf(stderr, "Usage: %s <N> <input dir|packed file> <output dir|packed file> [--threads=T] [--band=R] [--check] [--scalar]\n", prog);
+    return 1;
+}
+
+int main(int argc, char* argv[]) {
+    unsigned long int threads = std::thread::hardware_concurrency();
+    long int band = 0;
+    bool check = false;
+    int nargs = 1;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--threads=", 10) == 0) threads = strtoul(argv[i] + 10, NULL, 10);
+        else if (strncmp(argv[i], "--band=", 7) == 0) band = strtol(argv[i] + 7, NULL, 10);
+        else if (strcmp(argv[i], "--check") == 0) check = true;
+        else if (strcmp(argv[i], "--scalar") == 0) cnn_force_scalar = true;
+        else if (strncmp(argv[i], "--", 2) == 0) return usage(argv[0]);
+        else argv[nargs++] = argv[i];
+    }
+    argc = nargs;
+    if (argc != 4) return usage(argv[0]);
+    int n = atoi(argv[1]);
+    if (n < 8 || n % 8 != 0 || n > CNN_MAX_N) {
+        fprintf(stderr, "Error: N must be a positive multiple of 8 no larger than %d\n", CNN_MAX_N);
+        return 1;
+    }
+    int pool_dim = cnn_pool_dim(n);
+    if (band <= 0 || band > pool_dim) band = pool_dim;
+
+    batch_job job;
+    job.n = n;
+    job.in_fd = job.out_fd = -1;
+    job.band = (int)band;
+    job.bands = (pool_dim + job.band - 1) / job.band;
+    job.next = 0;
+    job.failed = false;
+
+    struct stat st;
+    if (stat(argv[2], &st) != 0) {
+        fprintf(stderr, "Error: Unable to open %s\n", argv[2]);
+        return 1;
+    }
+    job.packed = !S_ISDIR(st.st_mode);
+    if (job.packed) {
+        if (st.st_size == 0 || st.st_size % cnn_input_bytes(n) != 0) {
+            fprintf(stderr, "Error: %s is not a whole number of %zu-byte input images\n", argv[2], cnn_input_bytes(n));
+            return 1;
+        }
+        size_t count = st.st_size / cnn_input_bytes(n);
+        for (size_t i = 0; i < count; i++) {
+            batch_image img;
+            img.in_off = (off_t)(i * cnn_input_bytes(n));
+            img.out_off = (off_t)(i * cnn_output_bytes(n));
+            job.images.push_back(img);
+        }
+        job.in_fd = open(argv[2], O_RDONLY);
+        job.out_fd = create_output(argv[3], (off_t)(count * cnn_output_bytes(n)));
+        if (job.in_fd < 0 || job.out_fd < 0) {
+            fprintf(stderr, "Error: Unable to open %s\n", job.in_fd < 0 ? argv[2] : argv[3]);
+            return 1;
+        }
+    } else {
+        mkdir(argv[3], 0755);
+        if (!list_images(argv[2], argv[3], job.images) || job.images.empty()) {
+            fprintf(stderr, "Error: No *.in images in %s\n", argv[2]);
+            return 1;
+        }
+        for (const batch_image &img : job.images) {
+            if (stat(img.in_path.c_str(), &st) != 0 || (size_t)st.st_size != cnn_input_bytes(n)) {
+                fprintf(stderr, "Error: %s is not a %zu-byte input image\n", img.in_path.c_str(), cnn_input_bytes(n));
+                return 1;
+            }
+            int fd = create_output(img.out_path.c_str(), (off_t)cnn_output_bytes(n));
+            if (fd < 0) {
+                fprintf(stderr, "Error: Unable to write file %s\n", img.out_path.c_str());
+                return 1;
+            }
+            close(fd);
+        }
+    }
+
+    size_t count = job.images.size();
+    size_t work = count * job.bands;
+    if (threads == 0) threads = 1;
+    if (threads > work) threads = work;
+    double start = now();
+    std::vector<std::thread> pool;
+    for (unsigned long int t = 1; t < threads; t++) pool.push_back(std::thread(batch_worker, &job));
+    batch_worker(&job);
+    for (std::thread &t : pool) t.join();
+    double elapsed = now() - start;
+    if (job.failed) return 1;
+
+    size_t pad = cnn_row_pad(cnn_conv_dim(n));
+    size_t worker_bytes = 4 * pad + 2 * pad * sizeof(int32_t) + n + cnn_out_row_bytes(n);
+    printf("# === CNN Batch =================\n");
+    printf("# Images                       = %zu of %dx%d (%s)\n", count, n, n, job.packed ? "packed" : "directory");
+    printf("# Bands                        = %d per image, %d pooled rows each\n", job.bands, job.band);
+    printf("# Threads                      = %lu\n", threads);
+    printf("# Kernel                       = %s\n", cnn_force_scalar || !cnn_have_avx2() ? "scalar" : "AVX2");
+    printf("# Line Buffer Per Worker       = %zu bytes\n", worker_bytes);
+    printf("# Wall Time                    = %.3f s\n", elapsed);
+    printf("# Throughput                   = %.1f images/s, %.1f MB/s of input\n", elapsed > 0 ? count / elapsed : 0.0,
+           elapsed > 0 ? count * cnn_input_bytes(n) / elapsed / 1e6 : 0.0);
+
+    if (check) {
+        std::vector<uint8_t> input, output, expected;
+        size_t failures = 0;
+        for (size_t i = 0; i < count; i++) {
+            const batch_image &img = job.images[i];
+            int in_fd = job.in_fd, out_fd = job.out_fd;
+            if (!job.packed) {
+                in_fd = open(img.in_path.c_str(), O_RDONLY);
+                out_fd = open(img.out_path.c_str(), O_RDONLY);
+            }
+            if (!check_image(n, in_fd, img.in_off, out_fd, img.out_off, input, output, expected)) {
+                if (job.packed) printf("FAIL image %zu\n", i);
+                else printf("FAIL %s\n", img.in_path.c_str());
+                failures++;
+            }
+            if (!job.packed) {
+                close(in_fd);
+                close(out_fd);
+            }
+        }
+        if (failures) {
+            printf("%zu mismatch(es)\n", failures);
+            return 1;
+        }
+        printf("all outputs match cnn_run\n");
+    }
+    return 0;
+}
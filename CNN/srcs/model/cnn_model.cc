@@ -0,0 +1,217 @@
+#include <string.h>
+#include <vector>
+#include "cnn_model.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CNN_X86 1
+#endif
+
+bool cnn_force_scalar = false;
+
+// Beat b of an 8-byte burst goes to index 7 - b of its word.
+static inline int burst_index(int i) { return (i & ~7) + 7 - (i & 7); }
+
+static inline int32_t activate(int32_t cres) { return cres >= 0 ? cres : -((-cres) >> 2); }
+
+void cnn_unpack_filter(const uint8_t *dram, int8_t filt[16]) {
+    for (int k = 0; k < 16; k++) filt[k] = (int8_t)dram[burst_index(k)];
+}
+
+// A word's bytes reversed is its burst order read as one big-endian load.
+void cnn_unpack_row(const uint8_t *dram_row, int n, int8_t *row) {
+    for (int w = 0; w < n; w += 8) {
+        uint64_t v;
+        memcpy(&v, dram_row + w, 8);
+        v = __builtin_bswap64(v);
+        memcpy(row + w, &v, 8);
+    }
+}
+
+static void conv_row_scalar(const int8_t *const rows[4], int conv_dim, const int8_t filt[16], int32_t *act) {
+    for (int c = 0; c < conv_dim; c++) {
+        int32_t cres = 0;
+        for (int i = 0; i < 4; i++)
+            for (int j = 0; j < 4; j++) cres += (int16_t)(rows[i][c + j] * filt[4 * i + j]);
+        act[c] = activate(cres);
+    }
+}
+
+#ifdef CNN_X86
+// Sixteen columns at a time: each row's four taps are sign-extended to
+// int16 and taken in pairs by madd, so one instruction does two MACs per
+// column into int32.  madd's halves hold columns 0-3/8-11 and 4-7/12-15.
+__attribute__((target("avx2")))
+static void conv_row_avx2(const int8_t *const rows[4], int conv_dim, const int8_t filt[16], int32_t *act) {
+    __m256i f[8];
+    for (int t = 0; t < 8; t++)
+        f[t] = _mm256_set1_epi32((uint16_t)filt[2 * t] | ((uint32_t)(uint16_t)filt[2 * t + 1] << 16));
+    const __m256i zero = _mm256_setzero_si256();
+    for (int c = 0; c < conv_dim; c += CNN_VEC) {
+        __m256i lo = zero, hi = zero;
+        for (int i = 0; i < 4; i++) {
+            const int8_t *p = rows[i] + c;
+            __m256i x0 = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *)(p + 0)));
+            __m256i x1 = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *)(p + 1)));
+            __m256i x2 = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *)(p + 2)));
+            __m256i x3 = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *)(p + 3)));
+            lo = _mm256_add_epi32(lo, _mm256_madd_epi16(_mm256_unpacklo_epi16(x0, x1), f[2 * i]));
+            lo = _mm256_add_epi32(lo, _mm256_madd_epi16(_mm256_unpacklo_epi16(x2, x3), f[2 * i + 1]));
+            hi = _mm256_add_epi32(hi, _mm256_madd_epi16(_mm256_unpackhi_epi16(x0, x1), f[2 * i]));
+            hi = _mm256_add_epi32(hi, _mm256_madd_epi16(_mm256_unpackhi_epi16(x2, x3), f[2 * i + 1]));
+        }
+        __m256i cres[2] = { _mm256_permute2x128_si256(lo, hi, 0x20), _mm256_permute2x128_si256(lo, hi, 0x31) };
+        for (int h = 0; h < 2; h++) {
+            __m256i neg = _mm256_sub_epi32(zero, _mm256_srai_epi32(_mm256_sub_epi32(zero, cres[h]), 2));
+            __m256i a = _mm256_blendv_epi8(cres[h], neg, _mm256_cmpgt_epi32(zero, cres[h]));
+            _mm256_storeu_si256((__m256i *)(act + c + 8 * h), a);
+        }
+    }
+}
+#endif
+
+bool cnn_have_avx2() {
+#ifdef CNN_X86
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
+
+void cnn_conv_row(const int8_t *const rows[4], int conv_dim, const int8_t filt[16], int32_t *act) {
+#ifdef CNN_X86
+    static const bool avx2 = cnn_have_avx2();
+    if (avx2 && !cnn_force_scalar) {
+        conv_row_avx2(rows, conv_dim, filt, act);
+        return;
+    }
+#endif
+    conv_row_scalar(rows, conv_dim, filt, act);
+}
+
+void cnn_pool_row(const int32_t *act0, const int32_t *act1, int conv_dim, uint8_t *out) {
+    int pool_dim = (conv_dim + 1) / 2;
+    int row_bytes = (pool_dim + 7) / 8 * 8;
+    memset(out, 0, row_bytes);
+    for (int j = 0; j < pool_dim; j++) {
+        int c = 2 * j;
+        bool right = c + 1 < conv_dim;
+        int32_t sfin = act0[c] + (right ? act0[c + 1] : 0);
+        if (act1) sfin += act1[c] + (right ? act1[c + 1] : 0);
+        int32_t pavg = sfin >= 0 ? sfin >> 2 : -((-sfin) >> 2);
+        if (pavg > 127) pavg = 127;
+        else if (pavg < -128) pavg = -128;
+        out[burst_index(j)] = (uint8_t)pavg;
+    }
+}
+
+void cnn_run(const uint8_t *input, int n, uint8_t *output) {
+    int conv_dim = cnn_conv_dim(n), pool_dim = cnn_pool_dim(n);
+    int pad = cnn_row_pad(conv_dim);
+    int8_t filt[16];
+    cnn_unpack_filter(input, filt);
+
+    // the dut's data[][] frame, each row padded for the vector loads
+    std::vector<int8_t> data((size_t)n * pad, 0);
+    for (int r = 0; r < n; r++)
+        cnn_unpack_row(input + CNN_IMAGE_BASE + (size_t)r * n, n, &data[(size_t)r * pad]);
+
+    std::vector<int32_t> act(2 * (size_t)pad);
+    int32_t *act0 = &act[0], *act1 = &act[pad];
+    for (int k = 0; k < pool_dim; k++) {
+        int r = 2 * k;
+        const int8_t *rows[4];
+        for (int i = 0; i < 4; i++) rows[i] = &data[(size_t)(r + i) * pad];
+        cnn_conv_row(rows, conv_dim, filt, act0);
+        bool below = r + 1 < conv_dim;
+        if (below) {
+            for (int i = 0; i < 4; i++) rows[i] = &data[(size_t)(r + 1 + i) * pad];
+            cnn_conv_row(rows, conv_dim, filt, act1);
+        }
+        cnn_pool_row(act0, below ? act1 : NULL, conv_dim, output + (size_t)k * cnn_out_row_bytes(n));
+    }
+}
+
+void cnn_line_buffer_init(cnn_line_buffer *lb, int n, const int8_t filt[16]) {
+    lb->n = n;
+    lb->conv_dim = cnn_conv_dim(n);
+    lb->pad = cnn_row_pad(lb->conv_dim);
+    memcpy(lb->filt, filt, 16);
+    lb->lbuf.assign(4 * (size_t)lb->pad, 0);
+    lb->act.assign(2 * (size_t)lb->pad, 0);
+    lb->in_row.resize(n);
+    lb->out_row.resize(cnn_out_row_bytes(n));
+}
+
+// Conv row r is computed from ring slots r..r+3, after which slot r & 3
+// takes image row r + 4.
+bool cnn_run_band(cnn_line_buffer *lb, int k0, int k1, cnn_read_row read, cnn_write_row write, void *ctx) {
+    int n = lb->n, conv_dim = lb->conv_dim, pad = lb->pad;
+    int last_row = 2 * k1 - 1 < conv_dim ? 2 * k1 - 1 + 3 : n - 1;     // last image row the band needs
+    for (int r = 2 * k0; r < 2 * k0 + 4; r++) {
+        if (!read(ctx, r, lb->in_row.data())) return false;
+        cnn_unpack_row(lb->in_row.data(), n, &lb->lbuf[(size_t)(r & 3) * pad]);
+    }
+    for (int k = k0; k < k1; k++) {
+        const int8_t *rows[4];
+        bool below = false;
+        for (int h = 0; h < 2; h++) {
+            int r = 2 * k + h;
+            if (r >= conv_dim) break;
+            for (int i = 0; i < 4; i++) rows[i] = &lb->lbuf[(size_t)((r + i) & 3) * pad];
+            cnn_conv_row(rows, conv_dim, lb->filt, &lb->act[(size_t)h * pad]);
+            below = h == 1;
+            if (r + 4 <= last_row) {
+                if (!read(ctx, r + 4, lb->in_row.data())) return false;
+                cnn_unpack_row(lb->in_row.data(), n, &lb->lbuf[(size_t)(r & 3) * pad]);
+            }
+        }
+        cnn_pool_row(&lb->act[0], below ? &lb->act[pad] : NULL, conv_dim, lb->out_row.data());
+        if (!write(ctx, k, lb->out_row.data())) return false;
+    }
+    return true;
+}
+
+// Follows the dut's PROC state: po walks each 2x2 window, obuf fills from
+// byte 0 and is written out most significant byte first when full or at
+// the end of a pooled row.
+void cnn_run_reference(const uint8_t *input, int n, uint8_t *output) {
+    int conv_dim = cnn_conv_dim(n), pool_dim = cnn_pool_dim(n);
+    int8_t filt[16];
+    cnn_unpack_filter(input, filt);
+    std::vector<int8_t> data((size_t)n * n);
+    for (int r = 0; r < n; r++)
+        for (int c = 0; c < n; c++)
+            data[(size_t)r * n + c] = (int8_t)input[CNN_IMAGE_BASE + (size_t)r * n + burst_index(c)];
+
+    uint64_t obuf = 0;
+    int oi = 0;
+    size_t wrp = 0;
+    for (int rp = 0; rp < pool_dim; rp++) {
+        for (int cp = 0; cp < pool_dim; cp++) {
+            int32_t psum = 0;
+            for (int po = 0; po < 4; po++) {
+                int pr = 2 * rp + (po >> 1), pc = 2 * cp + (po & 1);
+                int32_t act = 0;
+                if (pr < conv_dim && pc < conv_dim) {
+                    int32_t cres = 0;
+                    for (int i = 0; i < 16; i++)
+                        cres += (int16_t)(data[(size_t)(pr + i / 4) * n + pc + i % 4] * filt[i]);
+                    act = activate(cres);
+                }
+                psum += act;
+            }
+            int32_t pavg = psum >= 0 ? psum >> 2 : -((-psum) >> 2);
+            int8_t pfin = pavg > 127 ? 127 : pavg < -128 ? -128 : (int8_t)pavg;
+            obuf |= (uint64_t)(uint8_t)pfin << (8 * oi);
+            if (oi == 7 || cp == pool_dim - 1) {
+                for (int bc = 0; bc < 8; bc++) output[wrp + bc] = (uint8_t)(obuf >> (8 * (7 - bc)));
+                wrp += 8;
+                obuf = 0;
+                oi = 0;
+            } else {
+                oi++;
+            }
+        }
+    }
+}
@@ -0,0 +1,88 @@
+#ifndef CNN_MODEL_H
+#define CNN_MODEL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+// Bit-exact C++ model of rtl/dut.sv: a 4x4 signed int8 convolution over an
+// N x N image, the activation act = cres >= 0 ? cres : -((-cres) >>> 2), a
+// 2x2 average pool with the same rounding toward zero, saturation to int8,
+// and the DRAM byte layouts the dut reads and writes.
+//
+// Input DRAM: the 16 filter bytes, then the image from CNN_IMAGE_BASE, one
+// row of N bytes after another.  Both come in 8-byte bursts whose beat b
+// lands at index 8w + 7 - b, so filt[k] is at byte (k & ~7) + 7 - (k & 7),
+// and pixel (r, c) at CNN_IMAGE_BASE + r * N + (c & ~7) + 7 - (c & 7).
+//
+// Output DRAM: POOL_DIM rows of pooled values, each padded with zeros to a
+// whole number of 8-byte words and written most significant obuf byte
+// first, so value j of a row is at byte (j & ~7) + 7 - (j & 7) of it.
+//
+// CONV_DIM = N - 3 and POOL_DIM = (CONV_DIM + 1) / 2.  A pooling window
+// that runs past the last conv row or column takes 0 there, as the dut
+// does.  N must be a multiple of 8; the dut's 11-bit counters also hold it
+// to CNN_MAX_N or less.
+
+#define CNN_FILTER_BYTES 16
+#define CNN_IMAGE_BASE   0x10
+#define CNN_MAX_N        1024
+
+static inline int cnn_conv_dim(int n) { return n - 3; }
+static inline int cnn_pool_dim(int n) { return (n - 2) / 2; }
+static inline int cnn_out_row_bytes(int n) { return (cnn_pool_dim(n) + 7) / 8 * 8; }
+static inline size_t cnn_input_bytes(int n) { return CNN_IMAGE_BASE + (size_t)n * n; }
+static inline size_t cnn_output_bytes(int n) { return (size_t)cnn_pool_dim(n) * cnn_out_row_bytes(n); }
+
+// Unpacks the filter from input DRAM.
+void cnn_unpack_filter(const uint8_t *dram, int8_t filt[16]);
+
+// Unpacks one image row of n bytes from its DRAM bytes.
+void cnn_unpack_row(const uint8_t *dram_row, int n, int8_t *row);
+
+// One row of activations: act[c] for c < conv_dim from image rows r..r+3,
+// each readable for at least cnn_row_pad(conv_dim) bytes.  act must hold
+// cnn_row_pad(conv_dim) values; those past conv_dim are left undefined.
+// The AVX2 kernel is used when the CPU has it, unless cnn_force_scalar is
+// set.
+#define CNN_VEC 16
+static inline int cnn_row_pad(int conv_dim) { return (conv_dim + CNN_VEC - 1) / CNN_VEC * CNN_VEC + 3; }
+void cnn_conv_row(const int8_t *const rows[4], int conv_dim, const int8_t filt[16], int32_t *act);
+extern bool cnn_force_scalar;
+bool cnn_have_avx2();
+
+// One row of output DRAM from two rows of activations (act1 NULL past the
+// last conv row), each with conv_dim values.
+void cnn_pool_row(const int32_t *act0, const int32_t *act1, int conv_dim, uint8_t *out);
+
+// The whole dut: cnn_input_bytes(n) of input DRAM to cnn_output_bytes(n)
+// of output DRAM.
+void cnn_run(const uint8_t *input, int n, uint8_t *output);
+
+// Streams an image through a ring of 4 unpacked rows, as the dut's
+// synthesis build does with lbuf[row & 3], so it needs O(N) memory however
+// many rows it covers.
+struct cnn_line_buffer {
+    int n, conv_dim, pad;
+    int8_t filt[16];
+    std::vector<int8_t> lbuf;       // 4 rows of pad bytes
+    std::vector<int32_t> act;       // the two conv rows of a pooled row
+    std::vector<uint8_t> in_row, out_row;   // DRAM bytes of an image row and a pooled row
+};
+
+// Fetches the DRAM bytes of image row r into dram_row, or stores pooled row
+// k; false stops the band.
+typedef bool (*cnn_read_row)(void *ctx, int r, uint8_t *dram_row);
+typedef bool (*cnn_write_row)(void *ctx, int k, const uint8_t *out_row);
+
+void cnn_line_buffer_init(cnn_line_buffer *lb, int n, const int8_t filt[16]);
+
+// Pooled rows k0..k1-1 of the output, reading image rows 2 * k0 onwards
+// once each; returns false if a callback did.
+bool cnn_run_band(cnn_line_buffer *lb, int k0, int k1, cnn_read_row read, cnn_write_row write, void *ctx);
+
+// The same, computed pixel by pixel in the dut's own order; slow, for
+// checking the kernels.
+void cnn_run_reference(const uint8_t *input, int n, uint8_t *output);
+
+#endif
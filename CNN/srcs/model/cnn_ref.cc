@@ -0,0 +1,183 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <vector>
+#include "cnn_model.h"
+
+// cnn_ref run <N> <input dram> <output dram> [--hex] [--scalar]
+//     computes the output DRAM image for one input DRAM image
+// cnn_ref gen <N> <count> <seed> <dir> [--hex] [--scalar]
+//     writes count random input images, <dir>/<i>.in, with their expected
+//     outputs, <dir>/<i>.out
+// cnn_ref check <N> <count> <seed>
+//     compares the AVX2 and scalar kernels against the pixel-by-pixel model
+//     on count random images
+//
+// DRAM files are raw bytes, or with --hex one byte per line in hex, as
+// $readmemh reads them.  --scalar turns off the AVX2 kernel.  Random images
+// mix uniform pixels and filters with ones drawn only from -128, -1, 0 and
+// 127, which drive the sums and the saturation to their limits.
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static inline uint64_t next_rand(uint64_t *s) {
+    // xorshift64*
+    uint64_t x = *s;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *s = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+static void random_input(uint64_t *s, int n, std::vector<uint8_t> &input) {
+    static const uint8_t extremes[4] = { 0x80, 0xff, 0x00, 0x7f };
+    input.assign(cnn_input_bytes(n), 0);
+    bool extreme = (next_rand(s) & 3) == 0;
+    for (size_t i = 0; i < input.size(); i++) {
+        uint64_t r = next_rand(s);
+        input[i] = extreme ? extremes[r >> 62] : (uint8_t)(r >> 56);
+    }
+}
+
+static bool read_dram(const char *path, bool hex, std::vector<uint8_t> &bytes, size_t size) {
+    FILE *in = fopen(path, hex ? "r" : "rb");
+    if (in == NULL) return false;
+    bytes.assign(size, 0);
+    bool ok = true;
+    if (hex) {
+        unsigned int v;
+        for (size_t i = 0; i < size && ok; i++) {
+            ok = fscanf(in, "%x", &v) == 1;
+            bytes[i] = (uint8_t)v;
+        }
+    } else {
+        ok = fread(bytes.data(), 1, size, in) == size;
+    }
+    fclose(in);
+    return ok;
+}
+
+static bool write_dram(const char *path, bool hex, const std::vector<uint8_t> &bytes) {
+    FILE *out = fopen(path, hex ? "w" : "wb");
+    if (out == NULL) return false;
+    bool ok = true;
+    if (hex) {
+        for (uint8_t b : bytes) fprintf(out, "%02x\n", b);
+    } else {
+        ok = fwrite(bytes.data(), 1, bytes.size(), out) == bytes.size();
+    }
+    return fclose(out) == 0 && ok;
+}
+
+static int usage(const char *prog) {
+    fprintf(stderr, "Usage: %s run <N> <input dram> <output dram> [--hex] [--scalar]\n", prog);
+    fprintf(stderr, "       %s gen <N> <count> <seed> <dir> [--hex] [--scalar]\n", prog);
+    fprintf(stderr, "       %s check <N> <count> <seed>\n", prog);
+    return 1;
+}
+
+int main(int argc, char* argv[]) {
+    bool hex = false;
+    int nargs = 1;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--hex") == 0) hex = true;
+        else if (strcmp(argv[i], "--scalar") == 0) cnn_force_scalar = true;
+        else argv[nargs++] = argv[i];
+    }
+    argc = nargs;
+    if (argc < 3) return usage(argv[0]);
+    const char *mode = argv[1];
+    int n = atoi(argv[2]);
+    if (n < 8 || n % 8 != 0 || n > CNN_MAX_N) {
+        fprintf(stderr, "Error: N must be a positive multiple of 8 no larger than %d\n", CNN_MAX_N);
+        return 1;
+    }
+
+    std::vector<uint8_t> input, output(cnn_output_bytes(n));
+    if (strcmp(mode, "run") == 0 && argc == 5) {
+        if (!read_dram(argv[3], hex, input, cnn_input_bytes(n))) {
+            fprintf(stderr, "Error: Unable to read %zu bytes from %s\n", cnn_input_bytes(n), argv[3]);
+            return 1;
+        }
+        cnn_run(input.data(), n, output.data());
+        if (!write_dram(argv[4], hex, output)) {
+            fprintf(stderr, "Error: Unable to write file %s\n", argv[4]);
+            return 1;
+        }
+        return 0;
+    }
+
+    if (strcmp(mode, "gen") == 0 && argc == 6) {
+        unsigned long int count = strtoul(argv[3], NULL, 10);
+        uint64_t s = strtoull(argv[4], NULL, 10) * 0x9E3779B97F4A7C15ULL + 1;
+        const char *dir = argv[5];
+        mkdir(dir, 0755);
+        double model_time = 0;
+        for (unsigned long int i = 0; i < count; i++) {
+            random_input(&s, n, input);
+            double start = now();
+            cnn_run(input.data(), n, output.data());
+            model_time += now() - start;
+            char path[4096];
+            snprintf(path, sizeof(path), "%s/%lu.in", dir, i);
+            bool ok = write_dram(path, hex, input);
+            if (ok) {
+                snprintf(path, sizeof(path), "%s/%lu.out", dir, i);
+                ok = write_dram(path, hex, output);
+            }
+            if (!ok) {
+                fprintf(stderr, "Error: Unable to write file %s\n", path);
+                return 1;
+            }
+        }
+        printf("%lu images of %dx%d written to %s/ (%s kernel, %.3f ms per image)\n", count, n, n, dir,
+               cnn_force_scalar || !cnn_have_avx2() ? "scalar" : "AVX2", count ? model_time / count * 1e3 : 0.0);
+        return 0;
+    }
+
+    if (strcmp(mode, "check") == 0 && argc == 5) {
+        unsigned long int count = strtoul(argv[3], NULL, 10);
+        uint64_t s = strtoull(argv[4], NULL, 10) * 0x9E3779B97F4A7C15ULL + 1;
+        std::vector<uint8_t> expected(output.size());
+        double ref_time = 0, kernel_time[2] = { 0, 0 };
+        int kernels = cnn_have_avx2() ? 2 : 1;
+        unsigned long int failures = 0;
+        for (unsigned long int i = 0; i < count; i++) {
+            random_input(&s, n, input);
+            double start = now();
+            cnn_run_reference(input.data(), n, expected.data());
+            ref_time += now() - start;
+            for (int k = 0; k < kernels; k++) {
+                cnn_force_scalar = (k == 0);
+                start = now();
+                cnn_run(input.data(), n, output.data());
+                kernel_time[k] += now() - start;
+                if (output != expected) {
+                    size_t b = 0;
+                    while (output[b] == expected[b]) b++;
+                    printf("FAIL image %lu, %s kernel: output byte %zu is %02x, expected %02x\n", i,
+                           k ? "AVX2" : "scalar", b, output[b], expected[b]);
+                    failures++;
+                }
+            }
+        }
+        double per = count ? 1e3 / count : 0.0;
+        printf("%lu images of %dx%d: reference %.3f ms, scalar %.3f ms", count, n, n, ref_time * per, kernel_time[0] * per);
+        if (kernels == 2) printf(", AVX2 %.3f ms", kernel_time[1] * per);
+        printf(" per image\n");
+        if (failures) {
+            printf("%lu mismatch(es)\n", failures);
+            return 1;
+        }
+        printf("all outputs match\n");
+        return 0;
+    }
+    return usage(argv[0]);
+}
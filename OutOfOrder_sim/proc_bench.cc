@@ -0,0 +1,263 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <string>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "proc_gen.h"
+
+// proc_bench [--update] [--runs=N] [--insts=N] [--sim=PATH]
+//
+// Regression: sim runs a short trace of every proc_gen pattern at each point
+// of a ROB x IQ x WIDTH matrix, and its whole output, timing lines included,
+// must match that run's file in bench_golden/ byte for byte; --update
+// rewrites the files instead.  Longer traces then go through the unit
+// configuration, memory model and branch predictor, with --stats, at one
+// point each: every pattern with fu_example.cfg, the mixed pattern (the one
+// with loads, stores and branches) with each of the others and with all
+// three.  Throughput: sim then runs an --insts
+// instruction trace (default 1000000) of every pattern at a few points and
+// the best of --runs (default 3) is reported as simulated KIPS and cycles
+// per second, with peak RSS.  Exits non-zero if any output differs from its
+// golden file or has none.
+//
+// Traces are generated into bench_traces/; the long ones once and reused.
+
+#define BENCH_DIR    "bench_traces"
+#define GOLDEN_DIR   "bench_golden"
+#define GOLDEN_INSTS 500
+#define MODEL_INSTS  4000
+
+static const int golden_rob[] = { 16, 64, 256 };
+static const int golden_iq[] = { 8, 32 };
+static const int golden_width[] = { 2, 8 };
+static const int model_point[3] = { 128, 32, 4 };
+static const struct golden_model {
+    const char *name;
+    bool all_patterns;      // otherwise mixed only
+    const char *options[6];
+} golden_models[] = {
+    { "fu", true, { "--fu=fu_example.cfg", "--stats", NULL } },
+    { "mem", false, { "--mem=64,8192,2,65536,4", "--mshr=4", "--lsq=16", "--stats", NULL } },
+    { "bp", false, { "--bp=gshare,10,6", "--stats", NULL } },
+    { "all", false, { "--fu=fu_example.cfg", "--mem=64,8192,2,65536,4", "--bp=hybrid,8,10,6,10", "--stats", NULL } },
+};
+static const int bench_points[][3] = { { 32, 8, 2 }, { 128, 32, 4 }, { 512, 128, 8 } };
+
+#define COUNT(a) (int)(sizeof(a) / sizeof(a[0]))
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static unsigned long int output_value(const std::string &out, const char *label) {
+    size_t p = out.find(label);
+    if (p == std::string::npos) return 0;
+    p = out.find('=', p);
+    return p == std::string::npos ? 0 : strtoul(out.c_str() + p + 1, NULL, 10);
+}
+
+// Runs sim <ROB> <IQ> <WIDTH> <trace> [options]; returns false if it fails.
+// options is NULL or NULL terminated.  With whole set, out gets all the
+// output, otherwise only the last few KB, where the results are.
+static bool run_sim(const char *sim, const int *point, const char *trace, const char *const *options, bool whole,
+                    std::string *out, double *seconds, long int *rss_kb) {
+    char args[3][16];
+    for (int i = 0; i < 3; i++) snprintf(args[i], sizeof(args[i]), "%d", point[i]);
+    const char *argv[16] = { sim, args[0], args[1], args[2], trace };
+    int n = 5;
+    for (int i = 0; options && options[i]; i++) argv[n++] = options[i];
+    argv[n] = NULL;
+
+    int fd[2];
+    if (pipe(fd) != 0) return false;
+    double start = now();
+    pid_t pid = fork();
+    if (pid < 0) return false;
+    if (pid == 0) {
+        dup2(fd[1], STDOUT_FILENO);
+        close(fd[0]);
+        close(fd[1]);
+        execv(sim, (char* const*)argv);
+        _exit(127);
+    }
+    close(fd[1]);
+
+    static char buf[1 << 16];
+    out->clear();
+    ssize_t r;
+    while ((r = read(fd[0], buf, sizeof(buf))) > 0) {
+        out->append(buf, (size_t)r);
+        if (!whole && out->size() > 8192) out->erase(0, out->size() - 4096);
+    }
+    close(fd[0]);
+
+    int status;
+    struct rusage ru;
+    if (wait4(pid, &status, 0, &ru) != pid) return false;
+    *seconds = now() - start;
+    *rss_kb = ru.ru_maxrss;
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+static bool read_file(const char *path, std::string *s) {
+    FILE *in = fopen(path, "rb");
+    if (in == NULL) return false;
+    static char buf[1 << 16];
+    size_t n;
+    s->clear();
+    while ((n = fread(buf, 1, sizeof(buf), in)) > 0) s->append(buf, n);
+    fclose(in);
+    return true;
+}
+
+static bool write_file(const char *path, const std::string &s) {
+    FILE *out = fopen(path, "wb");
+    if (out == NULL) return false;
+    bool ok = fwrite(s.data(), 1, s.size(), out) == s.size();
+    return fclose(out) == 0 && ok;
+}
+
+// Prints the first line where out and golden part.
+static void print_first_diff(const std::string &out, const std::string &golden) {
+    size_t i = 0, line_start = 0;
+    int line = 1;
+    while (i < out.size() && i < golden.size() && out[i] == golden[i]) {
+        if (out[i] == '\n') {
+            line++;
+            line_start = i + 1;
+        }
+        i++;
+    }
+    size_t a = out.find('\n', line_start), b = golden.find('\n', line_start);
+    printf("  line %d:\n    got:      %s\n    expected: %s\n", line,
+           out.substr(line_start, a == std::string::npos ? std::string::npos : a - line_start).c_str(),
+           golden.substr(line_start, b == std::string::npos ? std::string::npos : b - line_start).c_str());
+}
+
+// Runs one golden case and compares its output with path, or with --update
+// writes it there; returns false if sim fails or the file cannot be written.
+static bool check_golden(const char *sim, const int *point, const char *trace, const char *const *options,
+                         const char *path, bool update, int *checked, int *failures) {
+    std::string out, golden;
+    double seconds;
+    long int rss_kb;
+    if (!run_sim(sim, point, trace, options, true, &out, &seconds, &rss_kb)) {
+        fprintf(stderr, "Error: %s failed on %s\n", sim, trace);
+        return false;
+    }
+    (*checked)++;
+    if (update) {
+        if (!write_file(path, out)) {
+            fprintf(stderr, "Error: Unable to write file %s\n", path);
+            return false;
+        }
+    } else if (!read_file(path, &golden)) {
+        printf("FAIL %s: no golden output\n", path);
+        (*failures)++;
+    } else if (out != golden) {
+        printf("FAIL %s: output differs\n", path);
+        print_first_diff(out, golden);
+        (*failures)++;
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    bool update = false;
+    int runs = 3;
+    unsigned long int insts = 1000000;
+    const char *sim = "./sim";
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--update") == 0) update = true;
+        else if (strncmp(argv[i], "--runs=", 7) == 0) runs = atoi(argv[i] + 7);
+        else if (strncmp(argv[i], "--insts=", 8) == 0) insts = strtoul(argv[i] + 8, NULL, 10);
+        else if (strncmp(argv[i], "--sim=", 6) == 0) sim = argv[i] + 6;
+        else {
+            fprintf(stderr, "Usage: %s [--update] [--runs=N] [--insts=N] [--sim=PATH]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (runs < 1 || insts == 0) {
+        fprintf(stderr, "Error: --runs and --insts must be positive\n");
+        return 1;
+    }
+
+    mkdir(BENCH_DIR, 0755);
+    if (update) mkdir(GOLDEN_DIR, 0755);
+
+    int failures = 0, checked = 0;
+    std::string out;
+    double seconds;
+    long int rss_kb;
+    for (int p = 0; p < PROC_GEN_PATTERNS; p++) {
+        char trace[128];
+        snprintf(trace, sizeof(trace), BENCH_DIR "/%s-%d.txt", proc_gen_names[p], GOLDEN_INSTS);
+        if (!proc_gen_write(trace, p, GOLDEN_INSTS, 1, false)) {
+            fprintf(stderr, "Error: Unable to write file %s\n", trace);
+            return 1;
+        }
+        for (int r = 0; r < COUNT(golden_rob); r++)
+            for (int q = 0; q < COUNT(golden_iq); q++)
+                for (int w = 0; w < COUNT(golden_width); w++) {
+                    int point[3] = { golden_rob[r], golden_iq[q], golden_width[w] };
+                    char path[128];
+                    snprintf(path, sizeof(path), GOLDEN_DIR "/%s-%d-%d-%d.txt", proc_gen_names[p], point[0], point[1], point[2]);
+                    if (!check_golden(sim, point, trace, NULL, path, update, &checked, &failures)) return 1;
+                }
+
+        snprintf(trace, sizeof(trace), BENCH_DIR "/%s-%d.bin", proc_gen_names[p], MODEL_INSTS);
+        if (!proc_gen_write(trace, p, MODEL_INSTS, 1, true)) {
+            fprintf(stderr, "Error: Unable to write file %s\n", trace);
+            return 1;
+        }
+        for (int m = 0; m < COUNT(golden_models); m++) {
+            const golden_model &gm = golden_models[m];
+            if (!gm.all_patterns && p != PROC_GEN_MIXED) continue;
+            char path[128];
+            snprintf(path, sizeof(path), GOLDEN_DIR "/%s-%d-%d-%d-%s.txt", proc_gen_names[p], model_point[0],
+                     model_point[1], model_point[2], gm.name);
+            if (!check_golden(sim, model_point, trace, gm.options, path, update, &checked, &failures)) return 1;
+        }
+    }
+    if (update) printf("%d golden outputs written to %s/\n", checked, GOLDEN_DIR);
+    else printf("%d of %d outputs match %s/\n", checked - failures, checked, GOLDEN_DIR);
+
+    printf("%-10s %8s %6s %6s %12s %10s %12s %10s\n", "pattern", "ROB_SIZE", "IQ", "WIDTH", "cycles", "KIPS",
+           "Mcycles/s", "peak RSS");
+    for (int p = 0; p < PROC_GEN_PATTERNS; p++) {
+        char trace[128];
+        snprintf(trace, sizeof(trace), BENCH_DIR "/%s-%lu.bin", proc_gen_names[p], insts);
+        if (access(trace, R_OK) != 0 && !proc_gen_write(trace, p, insts, 1, true)) {
+            fprintf(stderr, "Error: Unable to write file %s\n", trace);
+            return 1;
+        }
+        for (int b = 0; b < COUNT(bench_points); b++) {
+            double best = 0;
+            long int peak = 0;
+            for (int run = 0; run < runs; run++) {
+                if (!run_sim(sim, bench_points[b], trace, NULL, false, &out, &seconds, &rss_kb)) {
+                    fprintf(stderr, "Error: %s failed on %s\n", sim, trace);
+                    return 1;
+                }
+                if (run == 0 || seconds < best) best = seconds;
+                if (rss_kb > peak) peak = rss_kb;
+            }
+            unsigned long int count = output_value(out, "# Dynamic Instruction Count");
+            unsigned long int cycles = output_value(out, "# Cycles");
+            printf("%-10s %8d %6d %6d %12lu %10.0f %12.2f %7.1f MB\n", proc_gen_names[p], bench_points[b][0],
+                   bench_points[b][1], bench_points[b][2], cycles, count / best / 1e3, cycles / best / 1e6, peak / 1024.0);
+        }
+    }
+
+    if (failures) {
+        printf("%d output(s) differ from %s/\n", failures, GOLDEN_DIR);
+        return 1;
+    }
+    return 0;
+}
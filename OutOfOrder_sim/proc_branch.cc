@@ -0,0 +1,62 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "proc_branch.h"
+
+void branch_params_default(branch_params *br) {
+    br->enabled = false;
+    memset(&br->bp, 0, sizeof(br->bp));
+    br->penalty = 2;
+}
+
+// Parses ",<n>" count times into v; false unless that is the whole string.
+static bool parse_fields(const char *s, unsigned long int *v, int count) {
+    for (int i = 0; i < count; i++) {
+        if (*s++ != ',') return false;
+        char *end;
+        v[i] = strtoul(s, &end, 10);
+        if (end == s || *s == '-') return false;
+        s = end;
+    }
+    return *s == '\0';
+}
+
+int branch_parse_option(const char *arg, branch_params *br) {
+    unsigned long int v[4];
+    if (strncmp(arg, "--bp=", 5) == 0) {
+        const char *p = arg + 5;
+        bp_params &bp = br->bp;
+        memset(&bp, 0, sizeof(bp));
+        if (strncmp(p, "bimodal", 7) == 0) {
+            if (!parse_fields(p + 7, v, 1) || v[0] < 1 || v[0] > 30) return -1;
+            bp.bp_name = (char*)"bimodal";
+            bp.M2 = v[0];
+        } else if (strncmp(p, "gshare", 6) == 0) {
+            if (!parse_fields(p + 6, v, 2) || v[0] < 1 || v[0] > 30 || v[1] > v[0]) return -1;
+            bp.bp_name = (char*)"gshare";
+            bp.M1 = v[0];
+            bp.N = v[1];
+        } else if (strncmp(p, "hybrid", 6) == 0) {
+            if (!parse_fields(p + 6, v, 4) || v[0] < 1 || v[0] > 30 || v[1] < 1 || v[1] > 30 ||
+                v[2] > v[1] || v[3] < 1 || v[3] > 30)
+                return -1;
+            bp.bp_name = (char*)"hybrid";
+            bp.K = v[0];
+            bp.M1 = v[1];
+            bp.N = v[2];
+            bp.M2 = v[3];
+        } else {
+            return -1;
+        }
+        br->enabled = true;
+        return 1;
+    }
+    if (strncmp(arg, "--bp-penalty=", 13) == 0) {
+        char *end;
+        long n = strtol(arg + 13, &end, 10);
+        if (end == arg + 13 || *end != '\0' || n < 0 || n > 10000) return -1;
+        br->penalty = (int)n;
+        return 1;
+    }
+    return 0;
+}
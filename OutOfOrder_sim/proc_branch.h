@@ -0,0 +1,30 @@
+#ifndef PROC_BRANCH_H
+#define PROC_BRANCH_H
+
+#include "bp_predictor.h"
+
+// Branch prediction front end, enabled with --bp.  Op type 5 is a
+// conditional branch and carries its outcome in the trace.  Fetch predicts
+// every branch with sim_bp's predictor and trains it straight away with the
+// outcome, exactly as sim_bp does, so a run mispredicts the same branches
+// sim_bp reports for the same branch stream.  Fetch stops behind a
+// mispredicted branch until the branch finishes executing and the redirect
+// penalty has passed.
+
+#define OP_BRANCH 5
+
+struct branch_params {
+    bool enabled;
+    bp_params bp;
+    int penalty;    // cycles from resolution to fetching the right path
+};
+
+void branch_params_default(branch_params *br);
+
+// Parses one of
+//   --bp=bimodal,<M2>  --bp=gshare,<M1>,<N>  --bp=hybrid,<K>,<M1>,<N>,<M2>
+//   --bp-penalty=<N>        (default 2)
+// Returns 1 if arg was one of them, 0 if not, -1 if it was malformed.
+int branch_parse_option(const char *arg, branch_params *br);
+
+#endif
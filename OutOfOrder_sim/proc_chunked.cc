@@ -0,0 +1,267 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include "sim_proc.h"
+#include "proc_chunked.h"
+
+using namespace std;
+
+// What a timing line shows of an instruction besides its timing.
+struct chunk_inst {
+    int op_type;
+    int dest, src1, src2;
+};
+
+struct trace_chunk {
+    size_t start, len;          // instructions of the chunk proper
+    size_t warm;                // instructions simulated before start
+    size_t tail;                // instructions fed after the chunk
+    int cycles;
+    bool failed;                // the trace could not be read again
+    vector<retired_timing> timing;     // warm-up and tail included
+    vector<chunk_inst> insts;           // the chunk proper, with --timing
+};
+
+// Streams one chunk's records, warm-up to tail, from the chunk's own view
+// of the trace file, keeping the chunk's instructions for its timing lines.
+class ChunkTraceSource : public TraceSource {
+public:
+    ChunkTraceSource(FileTraceSource *file, trace_chunk *ch, bool timing)
+        : file(file), ch(ch), timing(timing), pos(0) {}
+
+    int read(trace_record *out, int max) {
+        size_t end = ch->warm + ch->len + ch->tail;
+        int got = file->read(out, (int)min((size_t)max, end - pos));
+        for (int i = 0; timing && i < got; i++) {
+            if (pos + i < ch->warm || pos + i >= ch->warm + ch->len) continue;
+            chunk_inst inst = { out[i].op_type, out[i].dest, out[i].src1, out[i].src2 };
+            ch->insts.push_back(inst);
+        }
+        pos += got;
+        return got;
+    }
+
+private:
+    FileTraceSource *file;
+    trace_chunk *ch;
+    bool timing;
+    size_t pos;
+};
+
+static void chunk_worker(vector<trace_chunk> *chunks, atomic<size_t> *next, const char *trace_file,
+                         const proc_params *params, bool timing) {
+    for (;;) {
+        size_t i = next->fetch_add(1);
+        if (i >= chunks->size()) return;
+        trace_chunk &ch = (*chunks)[i];
+        FileTraceSource file;
+        if (!file.open(trace_file) || file.skip(ch.start - ch.warm) != ch.start - ch.warm) {
+            ch.failed = true;
+            continue;
+        }
+        ChunkTraceSource source(&file, &ch, timing);
+        Processor proc(*params, &source, false);
+        // the last warm-up instruction may retire alongside the chunk's first
+        if (timing) {
+            ch.timing.reserve(ch.warm + ch.len + ch.tail);
+            ch.insts.reserve(ch.len);
+            proc.timing_log = &ch.timing;
+        }
+        proc.run_until(ch.warm);
+        int begin = ch.warm ? proc.current_cycle : 0;
+        if (i + 1 == chunks->size()) proc.run();
+        else proc.run_until(ch.warm + ch.len);
+        ch.cycles = proc.current_cycle - begin;
+        // the chunk's own cycles begin where the one before it left off
+        for (retired_timing &t : ch.timing) t.fe_begin -= begin;
+    }
+}
+
+// Writes the chunks' timing lines as a single run would have.
+static void print_timing(const vector<trace_chunk> &chunks) {
+    vector<char> buf(1 << 16);
+    size_t len = 0;
+    int offset = 0;
+    for (const trace_chunk &ch : chunks) {
+        for (size_t j = 0; j < ch.len; j++) {
+            const retired_timing &t = ch.timing[ch.warm + j];
+            const chunk_inst &inst = ch.insts[j];
+            inst_timing line;
+            line.seq_num = (int)(ch.start + j);
+            line.op_type = inst.op_type;
+            line.dest = inst.dest;
+            line.src1 = inst.src1;
+            line.src2 = inst.src2;
+            int begin = t.fe_begin + offset;
+            for (int st = 0; st < NUM_STAGES; st++) {
+                line.begin[st] = begin;
+                line.duration[st] = t.duration[st];
+                begin += t.duration[st];
+            }
+            if (len > buf.size() - TIMING_LINE_MAX) {
+                fwrite(&buf[0], 1, len, stdout);
+                len = 0;
+            }
+            len = (size_t)(put_timing_line(&buf[len], &line) - &buf[0]);
+        }
+        offset += ch.cycles;
+    }
+    fwrite(&buf[0], 1, len, stdout);
+}
+
+int run_chunked(int argc, char* argv[]) {
+    unsigned long int threads = thread::hardware_concurrency();
+    unsigned long int num_chunks = 0, overlap = 10000;
+    bool timing = false, validate = false;
+    const char *fu_file = NULL;
+    mem_params mem;
+    mem_params_default(&mem);
+    branch_params br;
+    branch_params_default(&br);
+    string options;
+    bool bad_option = false;
+    int nargs = 1;
+    for (int i = 1; i < argc; i++) {
+        int r = mem_parse_option(argv[i], &mem);
+        if (r == 0) r = branch_parse_option(argv[i], &br);
+        if (r < 0) bad_option = true;
+        if (strncmp(argv[i], "--threads=", 10) == 0) threads = strtoul(argv[i] + 10, NULL, 10);
+        else if (strncmp(argv[i], "--chunks=", 9) == 0) num_chunks = strtoul(argv[i] + 9, NULL, 10);
+        else if (strncmp(argv[i], "--overlap=", 10) == 0) overlap = strtoul(argv[i] + 10, NULL, 10);
+        else if (strcmp(argv[i], "--timing") == 0) timing = true;
+        else if (strcmp(argv[i], "--validate") == 0) validate = true;
+        else if (strncmp(argv[i], "--fu=", 5) == 0) fu_file = argv[i] + 5;
+        else if (r == 0) {
+            argv[nargs++] = argv[i];
+            continue;
+        }
+        options += " ";
+        options += argv[i];
+    }
+    argc = nargs;
+
+    if (argc != 6 || bad_option) {
+        fprintf(stderr, "Usage: %s chunked <ROB_SIZE> <IQ_SIZE> <WIDTH> <tracefile> [--chunks=K] [--threads=N]\n", argv[0]);
+        fprintf(stderr, "       [--overlap=N] [--timing] [--validate] [options]; options are as for a single run\n");
+        return 1;
+    }
+    const char *trace_file = argv[5];
+    if (threads == 0) threads = 1;
+    if (num_chunks == 0) num_chunks = threads;
+
+    static fu_config fu;
+    if (fu_file) {
+        const char *error;
+        int line;
+        if (!fu_config_load(fu_file, &fu, &error, &line)) {
+            fprintf(stderr, "Error: %s:%d: %s\n", fu_file, line, error);
+            return 1;
+        }
+    }
+
+    proc_params params;
+    params.rob_size = strtoul(argv[2], NULL, 10);
+    params.iq_size = strtoul(argv[3], NULL, 10);
+    params.width = strtoul(argv[4], NULL, 10);
+    params.fu = fu_file ? &fu : NULL;
+    params.mem = mem.enabled ? &mem : NULL;
+    params.br = br.enabled ? &br : NULL;
+    params.stats = false;
+    if (!mem_lsq_fits(&mem, params.width)) {
+        fprintf(stderr, "Error: --lsq must be at least WIDTH\n");
+        return 1;
+    }
+
+    // one pass to size the chunks; each worker then streams its own
+    FileTraceSource counter;
+    if (!counter.open(trace_file)) {
+        fprintf(stderr, "Error: Unable to open file %s\n", trace_file);
+        return 1;
+    }
+    size_t n = counter.skip((size_t)-1);
+    if (counter.error) {
+        fprintf(stderr, "Error: Unable to read trace %s\n", trace_file);
+        return 1;
+    }
+
+    // a chunk's last instruction still shares the pipeline with everything
+    // the ROB and the four front-end latches behind it can hold, so that
+    // much of the next chunk follows it as it would in a single run
+    if (num_chunks > n) num_chunks = n ? n : 1;
+    vector<trace_chunk> chunks(num_chunks);
+    for (size_t i = 0; i < num_chunks; i++) {
+        chunks[i].start = n * i / num_chunks;
+        chunks[i].len = n * (i + 1) / num_chunks - chunks[i].start;
+        chunks[i].warm = min((size_t)overlap, chunks[i].start);
+        chunks[i].tail = min(params.rob_size + 4 * params.width, n - chunks[i].start - chunks[i].len);
+        chunks[i].cycles = 0;
+        chunks[i].failed = false;
+    }
+
+    if (threads > num_chunks) threads = num_chunks;
+    atomic<size_t> next(0);
+    vector<thread> pool;
+    for (unsigned long int t = 1; t < threads; t++)
+        pool.push_back(thread(chunk_worker, &chunks, &next, trace_file, &params, timing));
+    chunk_worker(&chunks, &next, trace_file, &params, timing);
+    for (thread &t : pool) t.join();
+    for (const trace_chunk &ch : chunks) {
+        if (!ch.failed) continue;
+        fprintf(stderr, "Error: Unable to read trace %s\n", trace_file);
+        return 1;
+    }
+
+    if (timing) print_timing(chunks);
+
+    long long cycles = 0;
+    for (const trace_chunk &ch : chunks) cycles += ch.cycles;
+
+    printf("# === Simulator Command =========\n");
+    printf("# ./sim chunked %s %s %s %s%s\n", argv[2], argv[3], argv[4], trace_file, options.c_str());
+    printf("# === Processor Configuration ===\n");
+    printf("# ROB_SIZE = %lu\n# IQ_SIZE  = %lu\n# WIDTH    = %lu\n", params.rob_size, params.iq_size, params.width);
+    printf("# === Simulation Results ========\n");
+    printf("# Dynamic Instruction Count    = %zu\n", n);
+    printf("# Cycles                       = %lld\n", cycles);
+    printf("# Instructions Per Cycle (IPC) = %.2f\n", cycles > 0 ? (double)n / cycles : 0.0);
+    printf("# Chunks                       = %zu (overlap %lu)\n", chunks.size(), overlap);
+
+    if (validate) {
+        // the serial run's cycles over each chunk's instructions
+        FileTraceSource source;
+        if (!source.open(trace_file)) {
+            fprintf(stderr, "Error: Unable to open file %s\n", trace_file);
+            return 1;
+        }
+        Processor proc(params, &source, false);
+        vector<int> serial(chunks.size());
+        int prev = 0;
+        for (size_t i = 0; i < chunks.size(); i++) {
+            if (i + 1 == chunks.size()) proc.run();
+            else proc.run_until(chunks[i].start + chunks[i].len);
+            serial[i] = proc.current_cycle - prev;
+            prev = proc.current_cycle;
+        }
+
+        printf("# === Boundary Error ============\n");
+        printf("# %6s %12s %12s %12s %10s %10s\n", "chunk", "first inst", "cycles", "serial", "error", "at end");
+        long long chunked_end = 0, serial_end = 0;
+        for (size_t i = 0; i < chunks.size(); i++) {
+            chunked_end += chunks[i].cycles;
+            serial_end += serial[i];
+            printf("  %6zu %12zu %12d %12d %+10d %+10lld\n", i, chunks[i].start, chunks[i].cycles, serial[i],
+                   chunks[i].cycles - serial[i], chunked_end - serial_end);
+        }
+        printf("# Serial cycles                = %d\n", proc.current_cycle);
+        printf("# Serial IPC                   = %.4f\n", proc.current_cycle > 0 ? (double)n / proc.current_cycle : 0.0);
+        printf("# Chunked IPC                  = %.4f\n", cycles > 0 ? (double)n / cycles : 0.0);
+        printf("# Cycle error                  = %+.3f%%\n",
+               proc.current_cycle > 0 ? (double)(cycles - proc.current_cycle) / proc.current_cycle * 100 : 0.0);
+    }
+    return 0;
+}
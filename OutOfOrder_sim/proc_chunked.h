@@ -0,0 +1,28 @@
+#ifndef PROC_CHUNKED_H
+#define PROC_CHUNKED_H
+
+// sim chunked <ROB_SIZE> <IQ_SIZE> <WIDTH> <tracefile> [--chunks=K] [--threads=N]
+//             [--overlap=N] [--timing] [--validate] [options]
+//
+// Parallel-in-time simulation of one configuration.  The trace is cut into
+// --chunks equal chunks (default: one per thread), each simulated by its own
+// processor on a pool of --threads workers (default: one per hardware
+// thread); every worker streams its chunk from the file, so memory does not
+// grow with the trace.  A chunk's processor first simulates up to --overlap
+// instructions (default 10000) from the end of the chunk before it, so its
+// pipeline, predictor and caches are warm when the chunk proper starts, and
+// it keeps fetching a ROB and four front-end bundles past the chunk's end
+// so that the chunk's last instructions see the same younger instructions
+// as in a single run.  A chunk's cycles run from the retirement of its last
+// warm-up instruction to that of its own last one, and the chunks' cycles
+// add up to the total.
+//
+// --timing prints the per-instruction timing lines of a single run, with
+// each chunk's cycles shifted to follow the one before it; with an overlap
+// reaching back to the start of the trace they are the single run's lines.
+// --validate also streams the trace through a serial run and reports, per
+// chunk, the cycles the serial run spent on the same instructions and the
+// error at each chunk boundary.  Other options are as for a single run.
+int run_chunked(int argc, char* argv[]);
+
+#endif
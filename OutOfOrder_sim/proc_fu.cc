@@ -0,0 +1,134 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "proc_fu.h"
+
+#define FU_MAX_LATENCY 1024
+
+static int find_class(const fu_config *cfg, const char *name) {
+    for (size_t c = 0; c < cfg->classes.size(); c++)
+        if (strcmp(cfg->classes[c].name, name) == 0) return (int)c;
+    return -1;
+}
+
+static bool parse_latency(const char *s, int *latency) {
+    char *end;
+    long v = strtol(s, &end, 10);
+    if (end == s || *end != '\0' || v < 1 || v > FU_MAX_LATENCY) return false;
+    *latency = (int)v;
+    return true;
+}
+
+// Adds a unit behind each port in "p,q,..."; false on a malformed list.
+static bool parse_ports(fu_config *cfg, fu_class *cls, char *list) {
+    for (char *tok = strtok(list, ","); tok; tok = strtok(NULL, ",")) {
+        char *end;
+        long port = strtol(tok, &end, 10);
+        if (end == tok || *end != '\0' || port < 0 || port >= FU_MAX_PORTS) return false;
+        if (cfg->num_units == FU_MAX_UNITS) return false;
+        int unit = cfg->num_units++;
+        cfg->unit_port[unit] = (int)port;
+        cfg->port_units[port] |= 1ULL << unit;
+        cls->units |= 1ULL << unit;
+        cls->num_units++;
+    }
+    return cls->num_units > 0;
+}
+
+static bool parse_line(fu_config *cfg, char *text, int *default_op_class, int *default_op_latency, const char **error) {
+    char *argv[8];
+    int argc = 0;
+    for (char *tok = strtok(text, " \t\r\n"); tok && argc < 8; tok = strtok(NULL, " \t\r\n"))
+        argv[argc++] = tok;
+    if (argc == 0) return true;
+
+    if (strcmp(argv[0], "fu") == 0) {
+        if (argc != 5) { *error = "expected: fu <name> <latency> <pipelined|unpipelined> <ports>"; return false; }
+        fu_class cls;
+        memset(&cls, 0, sizeof(cls));
+        if (strlen(argv[1]) >= sizeof(cls.name) || find_class(cfg, argv[1]) >= 0) {
+            *error = "bad or duplicate unit class name";
+            return false;
+        }
+        strcpy(cls.name, argv[1]);
+        if (!parse_latency(argv[2], &cls.latency)) { *error = "bad latency"; return false; }
+        if (strcmp(argv[3], "pipelined") == 0) cls.pipelined = true;
+        else if (strcmp(argv[3], "unpipelined") == 0) cls.pipelined = false;
+        else { *error = "expected pipelined or unpipelined"; return false; }
+        if (!parse_ports(cfg, &cls, argv[4])) {
+            *error = "bad port list (ports are 0..63, at most 64 units in all)";
+            return false;
+        }
+        cfg->classes.push_back(cls);
+        return true;
+    }
+
+    if (strcmp(argv[0], "op") == 0) {
+        if (argc != 3 && argc != 4) { *error = "expected: op <op type|*> <fu name> [latency]"; return false; }
+        int c = find_class(cfg, argv[2]);
+        if (c < 0) { *error = "unknown unit class (declare it with fu first)"; return false; }
+        int latency = cfg->classes[c].latency;
+        if (argc == 4 && !parse_latency(argv[3], &latency)) { *error = "bad latency"; return false; }
+        if (strcmp(argv[1], "*") == 0) {
+            *default_op_class = c;
+            *default_op_latency = latency;
+            return true;
+        }
+        char *end;
+        long op = strtol(argv[1], &end, 10);
+        if (end == argv[1] || *end != '\0' || op < 0 || op >= FU_MAX_OPS) { *error = "bad op type (0..255 or *)"; return false; }
+        cfg->op_class[op] = c;
+        cfg->op_latency[op] = latency;
+        return true;
+    }
+
+    *error = "unknown directive (expected fu or op)";
+    return false;
+}
+
+bool fu_config_load(const char *path, fu_config *cfg, const char **error, int *line) {
+    cfg->classes.clear();
+    cfg->num_units = 0;
+    memset(cfg->port_units, 0, sizeof(cfg->port_units));
+    for (int op = 0; op < FU_MAX_OPS; op++) cfg->op_class[op] = -1;
+    *line = 0;
+
+    FILE *in = fopen(path, "r");
+    if (in == NULL) {
+        *error = "unable to open file";
+        return false;
+    }
+
+    int default_op_class = -1, default_op_latency = 0;
+    char text[256];
+    while (fgets(text, sizeof(text), in)) {
+        ++*line;
+        char *comment = strchr(text, '#');
+        if (comment) *comment = '\0';
+        if (!parse_line(cfg, text, &default_op_class, &default_op_latency, error)) {
+            fclose(in);
+            return false;
+        }
+    }
+    fclose(in);
+
+    if (cfg->classes.empty()) {
+        *error = "no functional units declared";
+        return false;
+    }
+    if (default_op_class < 0) {
+        default_op_class = 0;
+        default_op_latency = cfg->classes[0].latency;
+    }
+    cfg->default_class = default_op_class;
+    cfg->default_latency = default_op_latency;
+    cfg->max_latency = default_op_latency;
+    for (int op = 0; op < FU_MAX_OPS; op++) {
+        if (cfg->op_class[op] < 0) {
+            cfg->op_class[op] = default_op_class;
+            cfg->op_latency[op] = default_op_latency;
+        }
+        if (cfg->op_latency[op] > cfg->max_latency) cfg->max_latency = cfg->op_latency[op];
+    }
+    return true;
+}
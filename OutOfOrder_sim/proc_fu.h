@@ -0,0 +1,51 @@
+#ifndef PROC_FU_H
+#define PROC_FU_H
+
+#include <stdint.h>
+#include <vector>
+
+// Functional unit configuration.  One directive per line, '#' to end of line
+// is a comment:
+//
+//   fu <name> <latency> <pipelined|unpipelined> <port>[,<port>...]
+//   op <op type|*> <fu name> [latency]
+//
+// A "fu" line declares a class of units with one unit behind each listed
+// issue port (0..63).  Each port issues at most one instruction per cycle,
+// whichever of its units takes it.  A pipelined unit accepts a new
+// instruction every cycle; an unpipelined one is busy until its instruction
+// completes.  An "op" line sends an op type (0..255) to a unit class,
+// optionally with its own latency; "op *" sets where all other op types go,
+// and without it they go to the first class declared.
+
+#define FU_MAX_UNITS 64
+#define FU_MAX_PORTS 64
+#define FU_MAX_OPS   256
+
+struct fu_class {
+    char name[32];
+    int latency;
+    bool pipelined;
+    int num_units;
+    uint64_t units;     // bit per unit
+};
+
+struct fu_config {
+    std::vector<fu_class> classes;
+    int num_units;
+    int unit_port[FU_MAX_UNITS];
+    uint64_t port_units[FU_MAX_PORTS];  // units issuing through each port
+    int op_class[FU_MAX_OPS];
+    int op_latency[FU_MAX_OPS];
+    int default_class, default_latency;
+    int max_latency;
+
+    int class_of(int op) const { return (unsigned)op < FU_MAX_OPS ? op_class[op] : default_class; }
+    int latency_of(int op) const { return (unsigned)op < FU_MAX_OPS ? op_latency[op] : default_latency; }
+};
+
+// Reads a configuration file; on failure returns false with error and the
+// offending line number (0 if the file could not be read).
+bool fu_config_load(const char *path, fu_config *cfg, const char **error, int *line);
+
+#endif
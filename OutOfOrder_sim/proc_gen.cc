@@ -0,0 +1,150 @@
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include "proc_trace.h"
+#include "proc_gen.h"
+
+const char *proc_gen_names[PROC_GEN_PATTERNS] = { "chain", "ilp", "mixed", "pressure" };
+
+#define GEN_REGS PROC_TRACE_REGS
+#define GEN_HISTORY 64      // mixed: recent destinations to read from
+
+int proc_gen_pattern(const char *name) {
+    for (int p = 0; p < PROC_GEN_PATTERNS; p++)
+        if (strcmp(name, proc_gen_names[p]) == 0) return p;
+    return -1;
+}
+
+static inline uint64_t next_rand(uint64_t *s) {
+    // xorshift64*
+    uint64_t x = *s;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *s = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+static inline unsigned int next_below(uint64_t *s, unsigned int n) { return (unsigned int)((next_rand(s) >> 32) % n); }
+
+// An op type drawn from percentages for types 0..5.
+static int pick_op(uint64_t *s, const int *weights) {
+    int r = (int)next_below(s, 100);
+    for (int op = 0; op < 5; op++) {
+        if (r < weights[op]) return op;
+        r -= weights[op];
+    }
+    return 5;
+}
+
+struct gen_state {
+    uint64_t rand;
+    unsigned long int n;            // instructions so far
+    uint64_t loop_pc;
+    unsigned int loop_len, pos;
+    int history[GEN_HISTORY];       // mixed: destinations, newest at n % GEN_HISTORY
+    int last_dest;
+};
+
+static void next_record(gen_state *g, int pattern, trace_record *rec) {
+    uint64_t *s = &g->rand;
+    static const int chain_ops[6] = { 50, 30, 20, 0, 0, 0 };
+    static const int ilp_ops[6] = { 80, 15, 5, 0, 0, 0 };
+    static const int mixed_ops[6] = { 35, 15, 10, 20, 10, 10 };
+    static const int pressure_ops[6] = { 40, 25, 35, 0, 0, 0 };
+
+    if (g->pos == g->loop_len) {
+        g->pos = 0;
+        if (next_below(s, 8) == 0) {
+            g->loop_pc += 0x1000;
+            g->loop_len = 16 + next_below(s, 49);
+        }
+    }
+    rec->pc = g->loop_pc + 4 * g->pos;
+    rec->mem_addr = 0;
+    rec->taken = false;
+    bool loop_end = (++g->pos == g->loop_len);
+
+    switch (pattern) {
+    case PROC_GEN_CHAIN:
+        rec->op_type = pick_op(s, chain_ops);
+        rec->src1 = g->last_dest;
+        rec->src2 = next_below(s, 10) < 3 ? (int)next_below(s, GEN_REGS) : -1;
+        rec->dest = (int)next_below(s, 8);
+        break;
+    case PROC_GEN_ILP: {
+        int c = (int)(g->n % 24);
+        rec->op_type = pick_op(s, ilp_ops);
+        rec->src1 = c;
+        rec->src2 = next_below(s, 2) ? 60 + (int)next_below(s, 7) : -1;   // never written
+        rec->dest = c;
+        break;
+    }
+    case PROC_GEN_MIXED: {
+        rec->op_type = loop_end ? 5 : pick_op(s, mixed_ops);
+        int srcs[2];
+        for (int i = 0; i < 2; i++) {
+            unsigned int back = 1;
+            while (back < GEN_HISTORY - 1 && next_below(s, 10) < 7) back++;
+            srcs[i] = next_below(s, 10) == 0 ? -1 : g->history[(g->n - back) % GEN_HISTORY];
+        }
+        rec->src1 = srcs[0];
+        rec->src2 = srcs[1];
+        rec->dest = (int)next_below(s, 64);
+        if (rec->op_type == 3 || rec->op_type == 4) {
+            // a few arrays, walked with a stride or hit at random
+            uint64_t base = 0x10000000ULL + ((uint64_t)next_below(s, 4) << 20);
+            uint64_t off = next_below(s, 2) ? (g->n * 8) & 0xffff : (next_rand(s) & 0xfff8);
+            rec->mem_addr = base + off;
+        }
+        if (rec->op_type == 4) rec->dest = -1;
+        if (rec->op_type == 5) {
+            rec->dest = -1;
+            rec->src2 = -1;
+            rec->taken = loop_end ? next_below(s, 10) != 0 : next_below(s, 10) < 3;
+        }
+        break;
+    }
+    default: {
+        int reg = (int)(g->n % GEN_REGS);
+        rec->op_type = pick_op(s, pressure_ops);
+        rec->src1 = (reg + GEN_REGS - 4 - (int)next_below(s, 16)) % GEN_REGS;   // written 4-19 ago
+        rec->src2 = next_below(s, 2) ? (reg + 1 + (int)next_below(s, 27)) % GEN_REGS : -1;   // 40-66 ago
+        rec->dest = reg;
+        break;
+    }
+    }
+    if (rec->dest != -1) g->last_dest = rec->dest;
+    g->history[g->n % GEN_HISTORY] = rec->dest;
+    g->n++;
+}
+
+bool proc_gen_write(const char *path, int pattern, unsigned long int count, uint64_t seed, bool binary) {
+    gen_state g;
+    g.rand = seed * 0x9E3779B97F4A7C15ULL + 1;
+    g.n = 0;
+    g.loop_pc = 0x400000;
+    g.loop_len = 16 + next_below(&g.rand, 49);
+    g.pos = 0;
+    for (int i = 0; i < GEN_HISTORY; i++) g.history[i] = -1;
+    g.last_dest = -1;
+
+    static TraceWriter writer;
+    FILE *text = NULL;
+    bool ok = binary ? writer.create(path) : (text = fopen(path, "w")) != NULL;
+    if (!ok) return false;
+    for (unsigned long int i = 0; i < count && ok; i++) {
+        trace_record rec;
+        next_record(&g, pattern, &rec);
+        if (binary) {
+            ok = writer.add(rec);
+            continue;
+        }
+        fprintf(text, "%" PRIx64 " %d %d %d %d", rec.pc, rec.op_type, rec.dest, rec.src1, rec.src2);
+        if (trace_is_mem_op(rec.op_type)) fprintf(text, " %" PRIx64, rec.mem_addr);
+        if (trace_is_branch(rec.op_type)) fprintf(text, " %c", rec.taken ? 't' : 'n');
+        fputc('\n', text);
+    }
+    if (binary) return writer.finish() && ok;
+    return fclose(text) == 0 && ok;
+}
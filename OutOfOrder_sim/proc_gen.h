@@ -0,0 +1,34 @@
+#ifndef PROC_GEN_H
+#define PROC_GEN_H
+
+#include <stdint.h>
+
+// Synthetic instruction trace generator.  Each pattern loads the pipeline
+// in a different way:
+//
+//   chain     one dependence chain: every instruction reads the result of
+//             the one before it, with latencies mixed 1, 2 and 5
+//   ilp       24 independent chains interleaved, mostly 1-cycle ops, so
+//             IPC is bounded by the machine rather than the program
+//   mixed     all six op types (loads and stores with addresses, branches
+//             with outcomes) reading results from a few instructions back
+//   pressure  every one of the 67 registers written in turn, then read 4 to
+//             19 and 40 to 66 instructions later; a third are 5-cycle ops, so
+//             the ROB and IQ fill with waiting instructions and IPC keeps
+//             rising up to a window of a hundred or so
+//
+// Instructions sit in loops of 16 to 64, so pcs repeat.  Output is
+// deterministic for a given pattern, length and seed.
+
+enum { PROC_GEN_CHAIN, PROC_GEN_ILP, PROC_GEN_MIXED, PROC_GEN_PRESSURE, PROC_GEN_PATTERNS };
+
+extern const char *proc_gen_names[PROC_GEN_PATTERNS];
+
+// Returns the pattern for a name, or -1.
+int proc_gen_pattern(const char *name);
+
+// Writes count instructions, as a text or binary trace; returns false on a
+// write error.
+bool proc_gen_write(const char *path, int pattern, unsigned long int count, uint64_t seed, bool binary);
+
+#endif
@@ -0,0 +1,315 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include "sim_proc.h"
+#include "proc_sweep.h"
+#include "proc_limits.h"
+
+using namespace std;
+
+// Register r is kept at index r + 1, so that a missing source reads index
+// 0, always ready at cycle 0; a missing destination writes LIMIT_NO_DEST,
+// which is never read.
+#define LIMIT_REGS 256
+#define LIMIT_NO_DEST LIMIT_REGS
+#define DIST_BINS 11        // 1, 2-3, 4-7, ..., 512-1023, 1024+
+
+struct limit_point {
+    int rob;                // 0: unbounded window
+    int width;
+    int ready[LIMIT_REGS + 1];
+    // cycles the last mask + 1 instructions entered the window and retired
+    vector<int> entered, retired;
+    unsigned long int mask;
+    int last_enter, last_retire;
+};
+
+struct limit_dist {
+    unsigned long int reads, no_writer;
+    unsigned long int bins[DIST_BINS];
+};
+
+static void limit_point_init(limit_point *pt, int rob, int width) {
+    pt->rob = rob;
+    pt->width = width;
+    for (int r = 0; r <= LIMIT_REGS; r++) pt->ready[r] = 0;
+    unsigned long int size = 1;
+    while (size <= (unsigned long int)max(rob, width)) size <<= 1;
+    pt->entered.assign(size, -1);
+    pt->retired.assign(size, -1);
+    pt->mask = size - 1;
+    pt->last_enter = 0;
+    pt->last_retire = 0;
+}
+
+// What a window needs of an instruction, with registers at index r + 1.
+struct limit_inst {
+    uint16_t src1, src2, dest, latency;
+};
+
+// Instructions first..first+n-1 of the trace through G windows at once, so
+// that their dependence chains overlap.  Each instruction enters no earlier
+// than the one before it, a cycle after the one WIDTH before it, and once
+// the one ROB_SIZE before it has retired; it retires likewise in order,
+// WIDTH a cycle, once it is done.
+template <int G>
+static void limit_points_run(limit_point **pts, const limit_inst *insts, int n, unsigned long int first) {
+    int *ready[G], *entered[G], *retired[G], *window[G];
+    unsigned long int mask[G], window_mask[G], rob[G], width[G];
+    int last_enter[G], last_retire[G];
+    for (int p = 0; p < G; p++) {
+        ready[p] = pts[p]->ready;
+        entered[p] = pts[p]->entered.data();
+        retired[p] = pts[p]->retired.data();
+        mask[p] = pts[p]->mask;
+        // an unbounded window reads a retire cycle of 0 for every instruction
+        window[p] = pts[p]->rob ? retired[p] : ready[p];
+        window_mask[p] = pts[p]->rob ? mask[p] : 0;
+        rob[p] = pts[p]->rob;
+        width[p] = pts[p]->width;
+        last_enter[p] = pts[p]->last_enter;
+        last_retire[p] = pts[p]->last_retire;
+    }
+    for (int k = 0; k < n; k++) {
+        limit_inst in = insts[k];
+        unsigned long int i = first + k;
+        for (int p = 0; p < G; p++) {
+            int enter = max(max(last_enter[p], entered[p][(i - width[p]) & mask[p]] + 1),
+                            window[p][(i - rob[p]) & window_mask[p]]);
+            entered[p][i & mask[p]] = enter;
+            last_enter[p] = enter;
+            int done = max(enter, max(ready[p][in.src1], ready[p][in.src2])) + in.latency;
+            ready[p][in.dest] = done;
+            int retire = max(max(done, last_retire[p]), retired[p][(i - width[p]) & mask[p]] + 1);
+            retired[p][i & mask[p]] = retire;
+            last_retire[p] = retire;
+        }
+    }
+    for (int p = 0; p < G; p++) {
+        pts[p]->last_enter = last_enter[p];
+        pts[p]->last_retire = last_retire[p];
+    }
+}
+
+// Runs the same instructions through every window, four at a time, on a
+// pool of worker threads.
+static void limits_worker(vector<limit_point *> *pts, atomic<size_t> *next,
+                          const limit_inst *insts, int n, unsigned long int first) {
+    for (;;) {
+        size_t p = next->fetch_add(4);
+        if (p >= pts->size()) return;
+        if (p + 4 <= pts->size()) limit_points_run<4>(&(*pts)[p], insts, n, first);
+        else for (; p < pts->size(); p++) limit_points_run<1>(&(*pts)[p], insts, n, first);
+    }
+}
+
+static void limits_run(vector<limit_point *> &pts, unsigned long int threads,
+                       const limit_inst *insts, int n, unsigned long int first) {
+    atomic<size_t> next(0);
+    vector<thread> pool;
+    for (unsigned long int t = 1; t < threads; t++)
+        pool.push_back(thread(limits_worker, &pts, &next, insts, n, first));
+    limits_worker(&pts, &next, insts, n, first);
+    for (thread &t : pool) t.join();
+}
+
+static inline bool limit_reg_ok(int r) { return r >= -1 && r < LIMIT_REGS - 1; }
+
+static inline int dist_bin(unsigned long int d) {
+    int b = 63 - __builtin_clzl(d);
+    return b < DIST_BINS - 1 ? b : DIST_BINS - 1;
+}
+
+static double limit_ipc(const limit_point &pt, unsigned long int n) {
+    return pt.last_retire > 0 ? (double)n / pt.last_retire : 0.0;
+}
+
+int run_limits(int argc, char* argv[]) {
+    unsigned long int threads = thread::hardware_concurrency();
+    const char *rob_arg = "16,32,64,128,256,512,1024", *width_arg = "1,2,4,8";
+    string options;
+    int nargs = 1;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--threads=", 10) == 0) {
+            threads = strtoul(argv[i] + 10, NULL, 10);
+            continue;
+        }
+        if (strncmp(argv[i], "--rob=", 6) == 0) rob_arg = argv[i] + 6;
+        else if (strncmp(argv[i], "--width=", 8) == 0) width_arg = argv[i] + 8;
+        else {
+            argv[nargs++] = argv[i];
+            continue;
+        }
+        options += " ";
+        options += argv[i];
+    }
+    argc = nargs;
+
+    vector<unsigned long int> rob_list, width_list;
+    if (argc != 3 || !parse_list(rob_arg, rob_list) || !parse_list(width_arg, width_list)) {
+        fprintf(stderr, "Usage: %s limits <tracefile> [--rob=list] [--width=list] [--threads=N]\n", argv[0]);
+        fprintf(stderr, "       lists are a,b,c or lo-hi or lo-hi:step\n");
+        return 1;
+    }
+    const char *trace_file = argv[2];
+    if (threads == 0) threads = 1;
+    sort(rob_list.begin(), rob_list.end());
+    rob_list.erase(unique(rob_list.begin(), rob_list.end()), rob_list.end());
+    sort(width_list.begin(), width_list.end());
+    width_list.erase(unique(width_list.begin(), width_list.end()), width_list.end());
+    rob_list.push_back(0);
+
+    FileTraceSource source;
+    if (!source.open(trace_file)) {
+        fprintf(stderr, "Error: Unable to open file %s\n", trace_file);
+        return 1;
+    }
+
+    // points[r * widths + w]; the unbounded window is the last row
+    vector<limit_point> points(rob_list.size() * width_list.size());
+    for (size_t r = 0; r < rob_list.size(); r++)
+        for (size_t w = 0; w < width_list.size(); w++)
+            limit_point_init(&points[r * width_list.size() + w], (int)rob_list[r], (int)width_list[w]);
+
+    static int df_ready[LIMIT_REGS + 1];
+    static long int last_writer[LIMIT_REGS + 1];
+    static limit_dist dist[LIMIT_REGS];
+    for (int r = 0; r < LIMIT_REGS; r++) last_writer[r] = -1;
+    int critical_path = 0;
+
+    // Instructions are decoded a few thousand at a time; the windows take
+    // them in blocks big enough to be worth handing to the worker threads.
+    vector<trace_record> block(4096);
+    vector<limit_inst> insts(1 << 16);
+    vector<limit_point *> pts;
+    for (limit_point &pt : points) pts.push_back(&pt);
+    if (threads > (pts.size() + 3) / 4) threads = (pts.size() + 3) / 4;
+    unsigned long int n = 0, first = 0;
+    int got;
+    do {
+        got = source.read(block.data(), (int)block.size());
+        for (int k = 0; k < got; k++, n++) {
+            const trace_record &rec = block[k];
+            if (!limit_reg_ok(rec.dest) || !limit_reg_ok(rec.src1) || !limit_reg_ok(rec.src2)) {
+                fprintf(stderr, "Error: record %lu of %s names a register outside -1..%d\n", n, trace_file, LIMIT_REGS - 2);
+                return 1;
+            }
+            int srcs[2] = { rec.src1 + 1, rec.src2 + 1 };
+            for (int s = 0; s < 2; s++) {
+                int r = srcs[s];
+                if (r == 0) continue;
+                limit_dist &d = dist[r];
+                d.reads++;
+                if (last_writer[r] < 0) d.no_writer++;
+                else d.bins[dist_bin(n - last_writer[r])]++;
+            }
+            int latency = get_latency(rec.op_type);
+            int done = max(df_ready[srcs[0]], df_ready[srcs[1]]) + latency;
+            if (done > critical_path) critical_path = done;
+            int dest = rec.dest == -1 ? LIMIT_NO_DEST : rec.dest + 1;
+            df_ready[dest] = done;
+            last_writer[dest] = (long int)n;
+            limit_inst &in = insts[n - first];
+            in.src1 = (uint16_t)srcs[0];
+            in.src2 = (uint16_t)srcs[1];
+            in.dest = (uint16_t)dest;
+            in.latency = (uint16_t)latency;
+        }
+        if (n > first && (n - first + block.size() > insts.size() || got < (int)block.size())) {
+            limits_run(pts, threads, insts.data(), (int)(n - first), first);
+            first = n;
+        }
+    } while (got == (int)block.size());
+    if (source.error) {
+        fprintf(stderr, "Error: %s in %s\n", source.error, trace_file);
+        return 1;
+    }
+
+    printf("# === Simulator Command =========\n");
+    printf("# ./sim limits %s%s\n", trace_file, options.c_str());
+    printf("# === Dataflow Limit ============\n");
+    printf("# Dynamic Instruction Count    = %lu\n", n);
+    printf("# Critical Path (cycles)       = %d\n", critical_path);
+    printf("# Dataflow IPC                 = %.2f\n", critical_path > 0 ? (double)n / critical_path : 0.0);
+
+    size_t widths = width_list.size();
+    printf("# === Window Limit IPC ==========\n");
+    printf("# %9s", "ROB\\WIDTH");
+    for (unsigned long int w : width_list) printf(" %7lu", w);
+    printf("\n");
+    for (size_t r = 0; r < rob_list.size(); r++) {
+        if (rob_list[r]) printf("  %9lu", rob_list[r]);
+        else printf("  %9s", "inf");
+        for (size_t w = 0; w < widths; w++) printf(" %7.2f", limit_ipc(points[r * widths + w], n));
+        printf("\n");
+    }
+
+    printf("# === Dependency Distance (%% of reads) ===\n");
+    printf("# %4s %12s %6s", "reg", "reads", "none");
+    static const char *bin_names[DIST_BINS] = {
+        "1", "2-3", "4-7", "8-15", "16-31", "32-63", "64-127", "128-255", "256-511", "512-1023", "1024+"
+    };
+    for (int b = 0; b < DIST_BINS; b++) printf(" %6s", bin_names[b]);
+    printf("\n");
+    limit_dist all;
+    memset(&all, 0, sizeof(all));
+    for (int r = 1; r <= LIMIT_REGS; r++) {
+        const limit_dist &d = r < LIMIT_REGS ? dist[r] : all;
+        if (r < LIMIT_REGS) {
+            if (d.reads == 0) continue;
+            all.reads += d.reads;
+            all.no_writer += d.no_writer;
+            for (int b = 0; b < DIST_BINS; b++) all.bins[b] += d.bins[b];
+            printf("  %4d", r - 1);
+        } else {
+            printf("  %4s", "all");
+        }
+        double scale = d.reads ? 100.0 / d.reads : 0.0;
+        printf(" %12lu %6.1f", d.reads, d.no_writer * scale);
+        for (int b = 0; b < DIST_BINS; b++) printf(" %6.1f", d.bins[b] * scale);
+        printf("\n");
+    }
+
+    // ROB sizes from where a width's limit reaches 75% of its unbounded
+    // window's to where it reaches 98%; below that the window alone sets
+    // IPC, above it the window no longer matters.
+    printf("# === Recommended Points ========\n");
+    int last = (int)rob_list.size() - 2;        // largest bounded window
+    size_t inf_row = (last + 1) * widths;
+    double prev_ipc = 0;
+    for (size_t w = 0; w < widths; w++) {
+        double inf_ipc = limit_ipc(points[inf_row + w], n);
+        bool gain = w == 0 || inf_ipc >= prev_ipc * 1.05;
+        double over = prev_ipc > 0 ? (inf_ipc / prev_ipc - 1) * 100 : 0.0;
+        prev_ipc = inf_ipc;
+        if (!gain) {
+            printf("# WIDTH %4lu: skip, %+.1f%% over WIDTH %lu\n", width_list[w], over, width_list[w - 1]);
+            continue;
+        }
+        int lo = -1, hi = -1;
+        for (int r = last; r >= 0; r--) {
+            if (rob_list[r] < width_list[w]) continue;
+            double ipc = limit_ipc(points[r * widths + w], n);
+            if (ipc >= inf_ipc * 0.75) lo = r;
+            if (ipc >= inf_ipc * 0.98) hi = r;
+        }
+        if (lo < 0) {
+            printf("# WIDTH %4lu: ROB above %lu (limit IPC %.2f there, %.2f unbounded)\n", width_list[w],
+                   rob_list[last], limit_ipc(points[last * widths + w], n), inf_ipc);
+            continue;
+        }
+        bool rising = hi < 0;
+        if (rising) hi = last;
+        printf("# WIDTH %4lu: ROB %lu", width_list[w], rob_list[lo]);
+        if (hi != lo) printf("-%lu", rob_list[hi]);
+        printf("%s (limit IPC %.2f", rising ? " and above" : "", limit_ipc(points[lo * widths + w], n));
+        if (hi != lo) printf("-%.2f", limit_ipc(points[hi * widths + w], n));
+        printf(", %.2f unbounded)\n", inf_ipc);
+    }
+    return 0;
+}
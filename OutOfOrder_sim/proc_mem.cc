@@ -0,0 +1,225 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "proc_mem.h"
+
+void mem_params_default(mem_params *mp) {
+    mp->enabled = false;
+    mp->block_size = 64;
+    mp->l1_size = 32768;
+    mp->l1_assoc = 4;
+    mp->l2_size = 262144;
+    mp->l2_assoc = 8;
+    mp->l1_latency = 2;
+    mp->l2_latency = 10;
+    mp->mem_latency = 100;
+    mp->mshrs = 8;
+    mp->lsq_size = 32;
+}
+
+// Parses exactly n comma separated numbers.
+static bool parse_numbers(const char *s, unsigned long int *v, int n) {
+    for (int i = 0; i < n; i++) {
+        char *end;
+        v[i] = strtoul(s, &end, 10);
+        if (end == s || *s == '-') return false;
+        if (i + 1 < n && *end != ',') return false;
+        s = end + 1;
+        if (i + 1 == n && *end != '\0') return false;
+    }
+    return true;
+}
+
+static bool is_pow2(unsigned long int v) { return v && !(v & (v - 1)); }
+
+static bool cache_shape_ok(unsigned long int size, unsigned long int assoc, unsigned long int block) {
+    if (size == 0) return true;
+    if (assoc == 0 || size % (block * assoc) != 0) return false;
+    return is_pow2(size / (block * assoc));
+}
+
+int mem_parse_option(const char *arg, mem_params *mp) {
+    unsigned long int v[5];
+    if (strncmp(arg, "--mem=", 6) == 0) {
+        if (!parse_numbers(arg + 6, v, 5) || !is_pow2(v[0]) || v[1] == 0) return -1;
+        if (!cache_shape_ok(v[1], v[2], v[0]) || !cache_shape_ok(v[3], v[4], v[0])) return -1;
+        mp->enabled = true;
+        mp->block_size = v[0];
+        mp->l1_size = v[1];
+        mp->l1_assoc = v[2];
+        mp->l2_size = v[3];
+        mp->l2_assoc = v[4];
+        return 1;
+    }
+    if (strncmp(arg, "--mem-lat=", 10) == 0) {
+        if (!parse_numbers(arg + 10, v, 3)) return -1;
+        for (int i = 0; i < 3; i++) if (v[i] < 1 || v[i] > 10000) return -1;
+        mp->l1_latency = (int)v[0];
+        mp->l2_latency = (int)v[1];
+        mp->mem_latency = (int)v[2];
+        return 1;
+    }
+    if (strncmp(arg, "--mshr=", 7) == 0) {
+        if (!parse_numbers(arg + 7, v, 1) || v[0] < 1 || v[0] > 1024) return -1;
+        mp->mshrs = (int)v[0];
+        return 1;
+    }
+    if (strncmp(arg, "--lsq=", 6) == 0) {
+        if (!parse_numbers(arg + 6, v, 1) || v[0] < 1 || v[0] > 65536) return -1;
+        mp->lsq_size = (int)v[0];
+        return 1;
+    }
+    return 0;
+}
+
+static int log2_exact(unsigned long int v) {
+    int bits = 0;
+    while ((1UL << bits) < v) bits++;
+    return bits;
+}
+
+void Cache::init(unsigned long int size, unsigned long int assoc_ways, unsigned long int block_size) {
+    reads = read_misses = writes = write_misses = writebacks = 0;
+    clock = 0;
+    block_bits = log2_exact(block_size);
+    if (size == 0) {
+        num_sets = assoc = 0;
+        return;
+    }
+    assoc = (int)assoc_ways;
+    num_sets = (int)(size / (block_size * assoc_ways));
+    tags.assign((size_t)num_sets * assoc, 0);
+    stamp.assign((size_t)num_sets * assoc, 0);
+    dirty.assign((size_t)num_sets * assoc, 0);
+}
+
+bool Cache::probe(uint64_t addr) const {
+    uint64_t block = addr >> block_bits;
+    size_t base = (size_t)(block & (uint64_t)(num_sets - 1)) * assoc;
+    for (int w = 0; w < assoc; w++)
+        if (stamp[base + w] && tags[base + w] == block) return true;
+    return false;
+}
+
+bool Cache::access(uint64_t addr, bool write, bool *writeback, uint64_t *wb_addr) {
+    uint64_t block = addr >> block_bits;
+    size_t base = (size_t)(block & (uint64_t)(num_sets - 1)) * assoc;
+    if (write) writes++;
+    else reads++;
+    clock++;
+    *writeback = false;
+
+    size_t victim = base;
+    for (int w = 0; w < assoc; w++) {
+        size_t i = base + w;
+        if (stamp[i] && tags[i] == block) {
+            stamp[i] = clock;
+            if (write) dirty[i] = 1;
+            return true;
+        }
+        if (stamp[i] < stamp[victim]) victim = i;
+    }
+
+    if (write) write_misses++;
+    else read_misses++;
+    if (stamp[victim] && dirty[victim]) {
+        *writeback = true;
+        *wb_addr = tags[victim] << block_bits;
+        writebacks++;
+    }
+    tags[victim] = block;
+    stamp[victim] = clock;
+    dirty[victim] = write;
+    return false;
+}
+
+MemorySystem::MemorySystem(const mem_params &p) : params(p) {
+    l1.init(p.l1_size, p.l1_assoc, p.block_size);
+    l2.init(p.l2_size, p.l2_assoc, p.block_size);
+    block_bits = log2_exact(p.block_size);
+    loads = forwarded = mshr_merges = mshr_stalls = stores = 0;
+    mem_reads = mem_writes = 0;
+}
+
+int MemorySystem::max_latency() const {
+    return params.l1_latency + (l2.present() ? params.l2_latency : 0) + params.mem_latency;
+}
+
+// Fetches a block that missed L1; returns the whole access latency.
+int MemorySystem::miss_latency(uint64_t addr) {
+    if (!l2.present()) {
+        mem_reads++;
+        return params.l1_latency + params.mem_latency;
+    }
+    bool writeback;
+    uint64_t wb_addr;
+    bool hit = l2.access(addr, false, &writeback, &wb_addr);
+    if (writeback) mem_writes++;
+    if (hit) return params.l1_latency + params.l2_latency;
+    mem_reads++;
+    return params.l1_latency + params.l2_latency + params.mem_latency;
+}
+
+void MemorySystem::write_back_l1(uint64_t addr) {
+    if (!l2.present()) {
+        mem_writes++;
+        return;
+    }
+    bool writeback;
+    uint64_t wb_addr;
+    l2.access(addr, true, &writeback, &wb_addr);
+    if (writeback) mem_writes++;
+}
+
+int MemorySystem::load(uint64_t addr, int now, int start) {
+    uint64_t block = addr >> block_bits;
+
+    // loads issue in cycle order, so a miss that has filled before now is
+    // finished for good
+    const mshr *pending = NULL;
+    size_t live = 0;
+    for (size_t i = 0; i < mshr_table.size(); i++) {
+        if (mshr_table[i].fill_cycle < now) continue;
+        mshr_table[live++] = mshr_table[i];
+    }
+    mshr_table.resize(live);
+    for (const mshr &m : mshr_table)
+        if (m.block == block && m.fill_cycle >= start) pending = &m;
+
+    // a merged load waits for the fill instead of reading L1
+    if (pending) {
+        loads++;
+        mshr_merges++;
+        int wait = pending->fill_cycle - start + 1;
+        return wait > params.l1_latency ? wait : params.l1_latency;
+    }
+
+    if ((int)mshr_table.size() >= params.mshrs && !l1.probe(addr)) {
+        mshr_stalls++;
+        return -1;
+    }
+
+    loads++;
+    bool writeback;
+    uint64_t wb_addr;
+    bool hit = l1.access(addr, false, &writeback, &wb_addr);
+    if (writeback) write_back_l1(wb_addr);
+    if (hit) return params.l1_latency;
+
+    int latency = miss_latency(addr);
+    mshr_table.push_back({block, start + latency - 1});
+    return latency;
+}
+
+void MemorySystem::store(uint64_t addr) {
+    stores++;
+    warm(addr, true);
+}
+
+void MemorySystem::warm(uint64_t addr, bool write) {
+    bool writeback;
+    uint64_t wb_addr;
+    bool hit = l1.access(addr, write, &writeback, &wb_addr);
+    if (writeback) write_back_l1(wb_addr);
+    if (!hit) miss_latency(addr);
+}
@@ -0,0 +1,104 @@
+#ifndef PROC_MEM_H
+#define PROC_MEM_H
+
+#include <stdint.h>
+#include <vector>
+
+// Data memory model, enabled with --mem.  Op types 3 and 4 are loads and
+// stores and carry the address they access; all other ops, and every op
+// without --mem, keep their fixed latencies.
+//
+// L1 and the optional L2 are set-associative, LRU, write-back and
+// write-allocate, as in cache_sim: an L1 miss reads the block from L2 and an
+// L1 dirty eviction writes it to L2.  A load that misses L1 holds one of
+// the MSHRs until its block arrives; later loads to that block merge with
+// the outstanding miss without reading L1, and a miss with every MSHR busy
+// cannot issue.
+// Stores write the cache when they retire.
+
+#define OP_LOAD  3
+#define OP_STORE 4
+
+struct mem_params {
+    bool enabled;
+    unsigned long int block_size;
+    unsigned long int l1_size, l1_assoc;
+    unsigned long int l2_size, l2_assoc;    // l2_size 0: no L2
+    int l1_latency, l2_latency, mem_latency;
+    int mshrs;
+    int lsq_size;
+};
+
+void mem_params_default(mem_params *mp);
+
+// Parses one of
+//   --mem=<BLOCKSIZE>,<L1_SIZE>,<L1_ASSOC>,<L2_SIZE>,<L2_ASSOC>
+//   --mem-lat=<L1>,<L2>,<memory>    (cycles; default 2,10,100)
+//   --mshr=<N>                      (default 8)
+//   --lsq=<N>                       (default 32)
+// Returns 1 if arg was one of them, 0 if not, -1 if it was malformed.
+int mem_parse_option(const char *arg, mem_params *mp);
+
+// Dispatch admits a group only when all of its memory ops fit the LSQ, so
+// one smaller than WIDTH can block forever.
+static inline bool mem_lsq_fits(const mem_params *mp, unsigned long int width) {
+    return !mp->enabled || (unsigned long int)mp->lsq_size >= width;
+}
+
+class Cache {
+public:
+    void init(unsigned long int size, unsigned long int assoc, unsigned long int block_size);
+    bool present() const { return num_sets > 0; }
+
+    // True if addr's block is cached; no state changes.
+    bool probe(uint64_t addr) const;
+
+    // Reads or writes addr, allocating its block on a miss; returns whether
+    // it hit.  A dirty block evicted to make room is reported in *wb_addr.
+    bool access(uint64_t addr, bool write, bool *writeback, uint64_t *wb_addr);
+
+    unsigned long int reads, read_misses, writes, write_misses, writebacks;
+
+private:
+    int num_sets, assoc, block_bits;
+    uint64_t clock;
+    std::vector<uint64_t> tags;     // block number, per way
+    std::vector<uint64_t> stamp;    // last use; 0 = invalid
+    std::vector<uint8_t> dirty;
+};
+
+class MemorySystem {
+public:
+    MemorySystem(const mem_params &params);
+
+    // Starts a load issued in cycle now whose access begins in cycle start;
+    // returns its latency, or -1 if it misses L1 while every MSHR is busy
+    // (counted in mshr_stalls; the caches are untouched).  now must not
+    // decrease between calls; start may.
+    int load(uint64_t addr, int now, int start);
+    void store(uint64_t addr);
+
+    // Touches addr's blocks as an access would, with no timing, MSHRs or
+    // load/store counts: for fast-forwarding past unsimulated instructions.
+    void warm(uint64_t addr, bool write);
+
+    int max_latency() const;
+
+    mem_params params;
+    Cache l1, l2;
+    unsigned long int loads, forwarded, mshr_merges, mshr_stalls, stores;
+    unsigned long int mem_reads, mem_writes;
+
+private:
+    struct mshr {
+        uint64_t block;
+        int fill_cycle;     // last cycle of the miss
+    };
+    std::vector<mshr> mshr_table;
+    int block_bits;
+
+    int miss_latency(uint64_t addr);
+    void write_back_l1(uint64_t addr);
+};
+
+#endif
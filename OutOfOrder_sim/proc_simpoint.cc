@@ -0,0 +1,368 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "sim_proc.h"
+#include "proc_simpoint.h"
+
+using namespace std;
+
+#define BBV_DIMS 16
+#define KMEANS_RESTARTS 5
+#define KMEANS_MAX_ITERS 100
+
+struct bbv {
+    double v[BBV_DIMS];
+};
+
+struct sim_point {
+    size_t interval;
+    size_t start, len;          // instructions
+    size_t warm_start;          // first instruction simulated in detail
+    double weight;              // share of all instructions
+    int cycles;
+};
+
+static uint64_t splitmix64(uint64_t *state) {
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+// Adds len instructions of the block at leader to v.  The block's column of
+// the projection matrix is drawn from a hash of its pc, uniform in [-1, 1),
+// so no table of blocks is kept.
+static void project_block(bbv *v, uint64_t leader, size_t len, uint64_t seed) {
+    uint64_t state = leader ^ seed;
+    for (int d = 0; d < BBV_DIMS; d += 4) {
+        uint64_t bits = splitmix64(&state);
+        for (int i = 0; i < 4; i++)
+            v->v[d + i] += len * ((double)((bits >> (16 * i)) & 0xffff) / 32768.0 - 1.0);
+    }
+}
+
+// Profiling pass: one projected basic block vector per interval, normalized
+// by the interval's length; lens gets each interval's instruction count.
+static bool profile_trace(const char *path, size_t interval, uint64_t seed, vector<bbv> &vectors, vector<size_t> &lens) {
+    FileTraceSource source;
+    if (!source.open(path)) return false;
+
+    vector<trace_record> buf(4096);
+    bbv cur;
+    memset(&cur, 0, sizeof(cur));
+    size_t in_interval = 0, block_len = 0;
+    uint64_t leader = 0, next_pc = 0;
+    bool block_ends = true;
+    int got;
+    do {
+        got = source.read(&buf[0], (int)buf.size());
+        for (int i = 0; i < got; i++) {
+            const trace_record &rec = buf[i];
+            if (block_ends || rec.pc != next_pc) {
+                if (block_len) project_block(&cur, leader, block_len, seed);
+                leader = rec.pc;
+                block_len = 0;
+            }
+            block_len++;
+            next_pc = rec.pc + 4;
+            block_ends = trace_is_branch(rec.op_type);
+            if (++in_interval == interval) {
+                project_block(&cur, leader, block_len, seed);
+                block_len = 0;
+                for (int d = 0; d < BBV_DIMS; d++) cur.v[d] /= (double)in_interval;
+                vectors.push_back(cur);
+                lens.push_back(in_interval);
+                memset(&cur, 0, sizeof(cur));
+                in_interval = 0;
+            }
+        }
+    } while (got == (int)buf.size());
+    if (source.error) return false;
+
+    if (in_interval) {
+        project_block(&cur, leader, block_len, seed);
+        for (int d = 0; d < BBV_DIMS; d++) cur.v[d] /= (double)in_interval;
+        vectors.push_back(cur);
+        lens.push_back(in_interval);
+    }
+    return true;
+}
+
+static double distance2(const bbv &a, const bbv &b) {
+    double sum = 0;
+    for (int d = 0; d < BBV_DIMS; d++) sum += (a.v[d] - b.v[d]) * (a.v[d] - b.v[d]);
+    return sum;
+}
+
+// k-means with k-means++ seeding; returns the sum of squared distances and
+// leaves each vector's cluster in assign.  Clusters may end up empty.
+static double kmeans(const vector<bbv> &vectors, int k, uint64_t *rng, vector<int> &assign) {
+    size_t n = vectors.size();
+    vector<bbv> centers;
+    vector<double> dist(n, DBL_MAX);
+    centers.push_back(vectors[splitmix64(rng) % n]);
+    while ((int)centers.size() < k) {
+        double total = 0;
+        for (size_t i = 0; i < n; i++) {
+            dist[i] = min(dist[i], distance2(vectors[i], centers.back()));
+            total += dist[i];
+        }
+        if (total == 0) break;
+        double pick = (double)(splitmix64(rng) >> 11) / (double)(1ULL << 53) * total;
+        size_t i = 0;
+        while (i + 1 < n && (pick -= dist[i]) > 0) i++;
+        centers.push_back(vectors[i]);
+    }
+    k = (int)centers.size();
+
+    assign.assign(n, -1);
+    double sse = 0;
+    for (int iter = 0; iter < KMEANS_MAX_ITERS; iter++) {
+        bool changed = false;
+        sse = 0;
+        for (size_t i = 0; i < n; i++) {
+            int best = 0;
+            double best_d = DBL_MAX;
+            for (int c = 0; c < k; c++) {
+                double d = distance2(vectors[i], centers[c]);
+                if (d < best_d) { best_d = d; best = c; }
+            }
+            if (assign[i] != best) { assign[i] = best; changed = true; }
+            sse += best_d;
+        }
+        if (!changed) break;
+        vector<bbv> sums(k);
+        vector<size_t> counts(k, 0);
+        memset(&sums[0], 0, k * sizeof(bbv));
+        for (size_t i = 0; i < n; i++) {
+            for (int d = 0; d < BBV_DIMS; d++) sums[assign[i]].v[d] += vectors[i].v[d];
+            counts[assign[i]]++;
+        }
+        for (int c = 0; c < k; c++)
+            if (counts[c])
+                for (int d = 0; d < BBV_DIMS; d++) centers[c].v[d] = sums[c].v[d] / counts[c];
+    }
+    return sse;
+}
+
+// Clusters the intervals and picks the one nearest each centroid.
+static void choose_points(const vector<bbv> &vectors, const vector<size_t> &lens, int k, uint64_t seed, vector<sim_point> &points) {
+    uint64_t rng = seed;
+    vector<int> assign, best_assign;
+    double best_sse = DBL_MAX;
+    for (int r = 0; r < KMEANS_RESTARTS; r++) {
+        double sse = kmeans(vectors, min(k, (int)vectors.size()), &rng, assign);
+        if (sse < best_sse) { best_sse = sse; best_assign = assign; }
+    }
+
+    size_t n = vectors.size(), total = 0;
+    vector<size_t> starts(n);
+    for (size_t i = 0; i < n; i++) { starts[i] = total; total += lens[i]; }
+
+    for (int c = 0; c < k; c++) {
+        bbv center;
+        memset(&center, 0, sizeof(center));
+        size_t members = 0, insts = 0;
+        for (size_t i = 0; i < n; i++) {
+            if (best_assign[i] != c) continue;
+            for (int d = 0; d < BBV_DIMS; d++) center.v[d] += vectors[i].v[d];
+            members++;
+            insts += lens[i];
+        }
+        if (members == 0) continue;
+        for (int d = 0; d < BBV_DIMS; d++) center.v[d] /= members;
+        size_t best = 0;
+        double best_d = DBL_MAX;
+        for (size_t i = 0; i < n; i++) {
+            if (best_assign[i] != c) continue;
+            double d = distance2(vectors[i], center);
+            if (d < best_d) { best_d = d; best = i; }
+        }
+        sim_point pt;
+        pt.interval = best;
+        pt.start = starts[best];
+        pt.len = lens[best];
+        pt.warm_start = pt.start;
+        pt.weight = (double)insts / total;
+        pt.cycles = 0;
+        points.push_back(pt);
+    }
+    sort(points.begin(), points.end(), [](const sim_point &a, const sim_point &b) { return a.start < b.start; });
+}
+
+// Feeds the processor only the detailed regions of the trace, warming it
+// functionally on every instruction in between.
+class SampledTraceSource : public TraceSource {
+public:
+    SampledTraceSource(FileTraceSource *file, const vector<sim_point> &points)
+        : proc(NULL), file(file), points(points), pos(0), next(0), scratch(4096) {}
+
+    int read(trace_record *out, int max) {
+        int filled = 0;
+        while (filled < max && next < points.size()) {
+            const sim_point &pt = points[next];
+            if (pos < pt.warm_start) {
+                int want = (int)min(scratch.size(), pt.warm_start - pos);
+                int got = file->read(&scratch[0], want);
+                for (int i = 0; i < got; i++) proc->warm(scratch[i]);
+                pos += got;
+                if (got < want) return filled;
+                continue;
+            }
+            int want = (int)min((size_t)(max - filled), pt.start + pt.len - pos);
+            int got = file->read(out + filled, want);
+            filled += got;
+            pos += got;
+            if (got < want) return filled;
+            if (pos == pt.start + pt.len) next++;
+        }
+        return filled;
+    }
+
+    Processor *proc;
+
+private:
+    FileTraceSource *file;
+    const vector<sim_point> &points;
+    size_t pos, next;
+    vector<trace_record> scratch;
+};
+
+int run_simpoint(int argc, char* argv[]) {
+    unsigned long int interval = 100000, k = 10, warmup = 10000, seed = 1;
+    bool full = false;
+    const char *fu_file = NULL;
+    mem_params mem;
+    mem_params_default(&mem);
+    branch_params br;
+    branch_params_default(&br);
+    string options;
+    bool bad_option = false;
+    int nargs = 1;
+    for (int i = 1; i < argc; i++) {
+        int r = mem_parse_option(argv[i], &mem);
+        if (r == 0) r = branch_parse_option(argv[i], &br);
+        if (r < 0) bad_option = true;
+        if (strncmp(argv[i], "--interval=", 11) == 0) interval = strtoul(argv[i] + 11, NULL, 10);
+        else if (strncmp(argv[i], "--k=", 4) == 0) k = strtoul(argv[i] + 4, NULL, 10);
+        else if (strncmp(argv[i], "--warmup=", 9) == 0) warmup = strtoul(argv[i] + 9, NULL, 10);
+        else if (strncmp(argv[i], "--seed=", 7) == 0) seed = strtoul(argv[i] + 7, NULL, 10);
+        else if (strcmp(argv[i], "--full") == 0) full = true;
+        else if (strncmp(argv[i], "--fu=", 5) == 0) fu_file = argv[i] + 5;
+        else if (r == 0) {
+            argv[nargs++] = argv[i];
+            continue;
+        }
+        options += " ";
+        options += argv[i];
+    }
+    argc = nargs;
+
+    if (argc != 6 || bad_option || interval == 0 || k == 0 || k > 1000) {
+        fprintf(stderr, "Usage: %s simpoint <ROB_SIZE> <IQ_SIZE> <WIDTH> <tracefile> [--interval=N] [--k=N]\n", argv[0]);
+        fprintf(stderr, "       [--warmup=N] [--seed=N] [--full] [options]; options are as for a single run\n");
+        return 1;
+    }
+    const char *trace_file = argv[5];
+
+    static fu_config fu;
+    if (fu_file) {
+        const char *error;
+        int line;
+        if (!fu_config_load(fu_file, &fu, &error, &line)) {
+            fprintf(stderr, "Error: %s:%d: %s\n", fu_file, line, error);
+            return 1;
+        }
+    }
+
+    proc_params params;
+    params.rob_size = strtoul(argv[2], NULL, 10);
+    params.iq_size = strtoul(argv[3], NULL, 10);
+    params.width = strtoul(argv[4], NULL, 10);
+    params.fu = fu_file ? &fu : NULL;
+    params.mem = mem.enabled ? &mem : NULL;
+    params.br = br.enabled ? &br : NULL;
+    params.stats = false;
+    if (!mem_lsq_fits(&mem, params.width)) {
+        fprintf(stderr, "Error: --lsq must be at least WIDTH\n");
+        return 1;
+    }
+
+    vector<bbv> vectors;
+    vector<size_t> lens;
+    if (!profile_trace(trace_file, interval, seed, vectors, lens)) {
+        fprintf(stderr, "Error: Unable to read trace %s\n", trace_file);
+        return 1;
+    }
+    size_t total = 0;
+    for (size_t len : lens) total += len;
+
+    vector<sim_point> points;
+    if (!vectors.empty()) choose_points(vectors, lens, (int)k, seed, points);
+
+    // a point's detailed warm-up never reaches back into the one before it
+    size_t prev_end = 0, detailed = 0;
+    for (sim_point &pt : points) {
+        pt.warm_start = pt.start - min((size_t)warmup, pt.start - prev_end);
+        prev_end = pt.start + pt.len;
+        detailed += prev_end - pt.warm_start;
+    }
+
+    FileTraceSource file;
+    if (!file.open(trace_file)) {
+        fprintf(stderr, "Error: Unable to open file %s\n", trace_file);
+        return 1;
+    }
+    SampledTraceSource source(&file, points);
+    Processor proc(params, &source, false);
+    source.proc = &proc;
+    unsigned long int fed = 0;
+    for (sim_point &pt : points) {
+        fed += pt.start - pt.warm_start;
+        proc.run_until(fed);
+        int begin = proc.current_cycle;
+        fed += pt.len;
+        proc.run_until(fed);
+        pt.cycles = proc.current_cycle - begin;
+    }
+
+    double cpi = 0;
+    for (const sim_point &pt : points) cpi += pt.weight * pt.cycles / pt.len;
+    double ipc = cpi > 0 ? 1 / cpi : 0.0;
+
+    printf("# === Simulator Command =========\n");
+    printf("# ./sim simpoint %s %s %s %s%s\n", argv[2], argv[3], argv[4], trace_file, options.c_str());
+    printf("# === Processor Configuration ===\n");
+    printf("# ROB_SIZE = %lu\n# IQ_SIZE  = %lu\n# WIDTH    = %lu\n", params.rob_size, params.iq_size, params.width);
+    printf("# === Simulation Points =========\n");
+    printf("# %10s %14s %10s %10s %6s\n", "interval", "start", "weight(%)", "cycles", "IPC");
+    for (const sim_point &pt : points)
+        printf("  %10zu %14zu %10.2f %10d %6.2f\n", pt.interval, pt.start, pt.weight * 100, pt.cycles,
+               pt.cycles > 0 ? (double)pt.len / pt.cycles : 0.0);
+    printf("# === Sampled Results ===========\n");
+    printf("# Dynamic Instruction Count    = %zu\n", total);
+    printf("# Intervals                    = %zu\n", vectors.size());
+    printf("# Simulation points            = %zu\n", points.size());
+    printf("# Detailed instructions        = %zu (%.2f%%)\n", detailed, total ? (double)detailed / total * 100 : 0.0);
+    printf("# Estimated IPC                = %.4f\n", ipc);
+
+    if (full) {
+        FileTraceSource full_file;
+        if (!full_file.open(trace_file)) {
+            fprintf(stderr, "Error: Unable to open file %s\n", trace_file);
+            return 1;
+        }
+        Processor full_proc(params, &full_file, false);
+        full_proc.run();
+        double full_ipc = full_proc.current_cycle > 0 ? (double)full_proc.retired_count / full_proc.current_cycle : 0.0;
+        printf("# === Full Run ==================\n");
+        printf("# Cycles                       = %d\n", full_proc.current_cycle);
+        printf("# Instructions Per Cycle (IPC) = %.4f\n", full_ipc);
+        printf("# Estimate error               = %+.2f%%\n", full_ipc > 0 ? (ipc - full_ipc) / full_ipc * 100 : 0.0);
+    }
+    return 0;
+}
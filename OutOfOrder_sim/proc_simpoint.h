@@ -0,0 +1,26 @@
+#ifndef PROC_SIMPOINT_H
+#define PROC_SIMPOINT_H
+
+// sim simpoint <ROB_SIZE> <IQ_SIZE> <WIDTH> <tracefile> [--interval=N] [--k=N]
+//              [--warmup=N] [--seed=N] [--full] [options]
+//
+// Sampled simulation.  A profiling pass cuts the trace into intervals of
+// --interval instructions (default 100000) and builds a basic block vector
+// for each: the share of the interval's instructions spent in each block,
+// where a block runs from a branch target to the next branch or break in
+// sequential pcs.  The vectors are reduced by a fixed random projection to
+// 16 dimensions and clustered by k-means into at most --k clusters (default
+// 10).  The interval nearest each centroid is that cluster's simulation
+// point, weighted by the cluster's share of the instructions.
+//
+// The sampled pass streams the trace once more.  Between simulation points
+// instructions only train the branch predictor and caches; each point is
+// simulated in detail after up to --warmup instructions (default 10000) of
+// detailed warm-up.  One processor runs all the points in trace order, so
+// its pipeline carries over from one point's end into the next one's
+// warm-up.  The points' CPIs combined by weight give the estimated IPC.
+// --full also runs the whole trace in detail and reports the estimate's
+// error.  Other options are as for a single run.
+int run_simpoint(int argc, char* argv[]);
+
+#endif
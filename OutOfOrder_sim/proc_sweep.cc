@@ -0,0 +1,171 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include "sim_proc.h"
+#include "proc_sweep.h"
+
+using namespace std;
+
+struct sweep_point {
+    proc_params params;
+    bool valid;
+    int cycles;
+    unsigned long int instructions;
+};
+
+bool parse_list(const char *arg, vector<unsigned long int> &values) {
+    const char *p = arg;
+    while (*p) {
+        char *end;
+        unsigned long int lo = strtoul(p, &end, 10);
+        if (end == p) return false;
+        unsigned long int hi = lo, step = 1;
+        if (*end == '-') {
+            p = end + 1;
+            hi = strtoul(p, &end, 10);
+            if (end == p || hi < lo) return false;
+            if (*end == ':') {
+                p = end + 1;
+                step = strtoul(p, &end, 10);
+                if (end == p || step == 0) return false;
+            }
+        }
+        for (unsigned long int v = lo; v <= hi; v += step) {
+            if (v == 0 || values.size() >= 4096) return false;
+            values.push_back(v);
+        }
+        if (*end == ',') end++;
+        else if (*end != '\0') return false;
+        p = end;
+    }
+    return !values.empty();
+}
+
+static void sweep_worker(vector<sweep_point> *points, atomic<size_t> *next, const vector<trace_record> *trace) {
+    for (;;) {
+        size_t i = next->fetch_add(1);
+        if (i >= points->size()) return;
+        sweep_point &pt = (*points)[i];
+        if (!pt.valid) continue;
+        ArrayTraceSource source(trace->data(), trace->size());
+        Processor proc(pt.params, &source, false);
+        proc.run();
+        pt.cycles = proc.current_cycle;
+        pt.instructions = proc.retired_count;
+    }
+}
+
+int run_sweep(int argc, char* argv[]) {
+    unsigned long int threads = thread::hardware_concurrency();
+    const char *fu_file = NULL;
+    mem_params mem;
+    mem_params_default(&mem);
+    branch_params br;
+    branch_params_default(&br);
+    string options;
+    bool bad_option = false;
+    int nargs = 1;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--threads=", 10) == 0) {
+            threads = strtoul(argv[i] + 10, NULL, 10);
+            continue;
+        }
+        int r = mem_parse_option(argv[i], &mem);
+        if (r == 0) r = branch_parse_option(argv[i], &br);
+        if (r < 0) bad_option = true;
+        if (strncmp(argv[i], "--fu=", 5) == 0) fu_file = argv[i] + 5;
+        else if (r == 0) {
+            argv[nargs++] = argv[i];
+            continue;
+        }
+        options += " ";
+        options += argv[i];
+    }
+    argc = nargs;
+
+    vector<unsigned long int> rob_list, iq_list, width_list;
+    if (argc != 6 || bad_option || !parse_list(argv[2], rob_list) || !parse_list(argv[3], iq_list) || !parse_list(argv[4], width_list)) {
+        fprintf(stderr, "Usage: %s sweep <ROB list> <IQ list> <WIDTH list> <tracefile> [--threads=N] [options]\n", argv[0]);
+        fprintf(stderr, "       lists are a,b,c or lo-hi or lo-hi:step; options are as for a single run\n");
+        return 1;
+    }
+    const char *trace_file = argv[5];
+
+    static fu_config fu;
+    if (fu_file) {
+        const char *error;
+        int line;
+        if (!fu_config_load(fu_file, &fu, &error, &line)) {
+            fprintf(stderr, "Error: %s:%d: %s\n", fu_file, line, error);
+            return 1;
+        }
+    }
+
+    vector<trace_record> trace;
+    if (!load_trace(trace_file, trace)) {
+        fprintf(stderr, "Error: Unable to read trace %s\n", trace_file);
+        return 1;
+    }
+
+    vector<sweep_point> points;
+    for (unsigned long int width : width_list)
+        for (unsigned long int rob : rob_list)
+            for (unsigned long int iq : iq_list) {
+                sweep_point pt;
+                pt.params.rob_size = rob;
+                pt.params.iq_size = iq;
+                pt.params.width = width;
+                pt.params.fu = fu_file ? &fu : NULL;
+                pt.params.mem = mem.enabled ? &mem : NULL;
+                pt.params.br = br.enabled ? &br : NULL;
+                pt.params.stats = false;
+                pt.valid = (width <= rob && width <= iq && mem_lsq_fits(&mem, width));
+                pt.cycles = 0;
+                pt.instructions = 0;
+                points.push_back(pt);
+            }
+
+    if (threads == 0) threads = 1;
+    if (threads > points.size()) threads = points.size();
+    atomic<size_t> next(0);
+    vector<thread> pool;
+    for (unsigned long int t = 1; t < threads; t++)
+        pool.push_back(thread(sweep_worker, &points, &next, &trace));
+    sweep_worker(&points, &next, &trace);
+    for (thread &t : pool) t.join();
+
+    printf("# === Simulator Command =========\n");
+    printf("# ./sim sweep %s %s %s %s%s\n", argv[2], argv[3], argv[4], trace_file, options.c_str());
+    printf("# === Sweep Results =============\n");
+    printf("# Dynamic Instruction Count    = %zu\n", trace.size());
+    printf("# %8s %8s %6s %12s %6s\n", "ROB_SIZE", "IQ_SIZE", "WIDTH", "Cycles", "IPC");
+    for (const sweep_point &pt : points) {
+        if (pt.valid)
+            printf("  %8lu %8lu %6lu %12d %6.2f\n", pt.params.rob_size, pt.params.iq_size, pt.params.width,
+                   pt.cycles, pt.cycles > 0 ? (double)pt.instructions / pt.cycles : 0.0);
+        else
+            printf("  %8lu %8lu %6lu %12s %6s\n", pt.params.rob_size, pt.params.iq_size, pt.params.width, "-", "-");
+    }
+
+    size_t k = 0;
+    for (unsigned long int width : width_list) {
+        printf("# === IPC Surface (WIDTH = %lu) ===\n", width);
+        printf("# %6s", "ROB\\IQ");
+        for (unsigned long int iq : iq_list) printf(" %6lu", iq);
+        printf("\n");
+        for (unsigned long int rob : rob_list) {
+            printf("  %6lu", rob);
+            for (size_t j = 0; j < iq_list.size(); j++, k++) {
+                const sweep_point &pt = points[k];
+                if (pt.valid && pt.cycles > 0) printf(" %6.2f", (double)pt.instructions / pt.cycles);
+                else printf(" %6s", "-");
+            }
+            printf("\n");
+        }
+    }
+    return 0;
+}
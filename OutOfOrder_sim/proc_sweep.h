@@ -0,0 +1,21 @@
+#ifndef PROC_SWEEP_H
+#define PROC_SWEEP_H
+
+#include <vector>
+
+// sim sweep <ROB list> <IQ list> <WIDTH list> <tracefile> [--threads=N] [options]
+//
+// Lists are "a,b,c", "lo-hi" or "lo-hi:step", or a mix ("32-128:32,256").
+// The trace is decoded once into memory and every (ROB_SIZE, IQ_SIZE,
+// WIDTH) point is simulated on a pool of --threads workers (default: one per
+// hardware thread), all reading the same decoded trace.  Prints an IPC table
+// and, per WIDTH, an IPC surface over ROB_SIZE x IQ_SIZE.  Points whose WIDTH
+// exceeds ROB_SIZE or IQ_SIZE can never rename or dispatch a full group and
+// are skipped.  The --fu and memory options of a single run apply to every
+// point.
+int run_sweep(int argc, char* argv[]);
+
+// Parses "a,b,lo-hi,lo-hi:step" into values; false on malformed input.
+bool parse_list(const char *arg, std::vector<unsigned long int> &values);
+
+#endif
@@ -0,0 +1,283 @@
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "proc_trace.h"
+
+int ArrayTraceSource::read(trace_record *out, int max) {
+    int n = 0;
+    while (n < max && next < count) out[n++] = records[next++];
+    return n;
+}
+
+FileTraceSource::FileTraceSource() {
+    binary = false;
+    error = NULL;
+    data = NULL;
+    size = pos = 0;
+    version = 0;
+    remaining = prev_pc = prev_addr = 0;
+}
+
+FileTraceSource::~FileTraceSource() {
+    if (data) munmap((void*)data, size);
+}
+
+bool FileTraceSource::open(const char *path) {
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return false;
+    }
+    size = (size_t)st.st_size;
+    if (size > 0) {
+        void *m = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (m == MAP_FAILED) {
+            close(fd);
+            return false;
+        }
+        madvise(m, size, MADV_SEQUENTIAL);
+        data = (const uint8_t*)m;
+    }
+    close(fd);
+
+    if (size >= PROC_TRACE_HDR_LEN) {
+        if (memcmp(data, PROC_TRACE_MAGIC, PROC_TRACE_MAGIC_LEN) == 0) version = 1;
+        else if (memcmp(data, PROC_TRACE_MAGIC_MEM, PROC_TRACE_MAGIC_LEN) == 0) version = 2;
+        else if (memcmp(data, PROC_TRACE_MAGIC_BR, PROC_TRACE_MAGIC_LEN) == 0) version = 3;
+    }
+    if (version) {
+        binary = true;
+        for (int i = 0; i < 8; i++) remaining |= (uint64_t)data[PROC_TRACE_MAGIC_LEN + i] << (8 * i);
+        pos = PROC_TRACE_HDR_LEN;
+    }
+    return true;
+}
+
+int FileTraceSource::read(trace_record *out, int max) {
+    return binary ? read_binary(out, max) : read_text(out, max);
+}
+
+size_t FileTraceSource::skip(size_t n) {
+    trace_record recs[256];
+    size_t done = 0;
+    while (done < n) {
+        int want = n - done < 256 ? (int)(n - done) : 256;
+        int got = read(recs, want);
+        done += (size_t)got;
+        if (got < want) break;
+    }
+    return done;
+}
+
+static inline bool is_space(uint8_t c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+// The text fields are read the way "in >> hex >> pc >> dec >> op ..." did:
+// leading whitespace, an optional sign, and for the pc an optional 0x.
+static inline bool parse_field(const uint8_t *d, size_t size, size_t *pos, bool hex, int64_t *value) {
+    size_t p = *pos;
+    while (p < size && is_space(d[p])) p++;
+    bool neg = false;
+    if (p < size && (d[p] == '-' || d[p] == '+')) neg = (d[p++] == '-');
+    if (hex && p + 1 < size && d[p] == '0' && (d[p + 1] | 0x20) == 'x') p += 2;
+    uint64_t v = 0;
+    size_t start = p;
+    for (; p < size; p++) {
+        uint8_t c = d[p];
+        int digit;
+        if (c >= '0' && c <= '9') digit = c - '0';
+        else if (hex && (c | 0x20) >= 'a' && (c | 0x20) <= 'f') digit = (c | 0x20) - 'a' + 10;
+        else break;
+        v = v * (hex ? 16 : 10) + (uint64_t)digit;
+    }
+    if (p == start) return false;
+    *value = neg ? -(int64_t)v : (int64_t)v;
+    *pos = p;
+    return true;
+}
+
+int FileTraceSource::read_text(trace_record *out, int max) {
+    int n = 0;
+    while (n < max) {
+        size_t p = pos;
+        int64_t pc, op, dst, s1, s2;
+        if (!parse_field(data, size, &p, true, &pc) || !parse_field(data, size, &p, false, &op) ||
+            !parse_field(data, size, &p, false, &dst) || !parse_field(data, size, &p, false, &s1) ||
+            !parse_field(data, size, &p, false, &s2)) {
+            pos = size;
+            break;
+        }
+        if (!trace_reg_ok(dst) || !trace_reg_ok(s1) || !trace_reg_ok(s2)) {
+            error = "register out of range";
+            pos = size;
+            break;
+        }
+        out[n].pc = (uint64_t)pc;
+        out[n].op_type = (int)op;
+        out[n].dest = (int)dst;
+        out[n].src1 = (int)s1;
+        out[n].src2 = (int)s2;
+        out[n].mem_addr = 0;
+        out[n].taken = false;
+
+        // an address or branch outcome may follow on the same line
+        size_t q = p;
+        while (q < size && (data[q] == ' ' || data[q] == '\t')) q++;
+        if (q < size && (data[q] == 't' || data[q] == 'n')) {
+            out[n].taken = (data[q] == 't') && trace_is_branch(out[n].op_type);
+            p = q + 1;
+        } else if (q < size && data[q] != '\n' && data[q] != '\r') {
+            int64_t addr;
+            if (!parse_field(data, size, &q, true, &addr)) {
+                pos = size;
+                break;
+            }
+            if (trace_is_mem_op(out[n].op_type)) out[n].mem_addr = (uint64_t)addr;
+            p = q;
+        }
+        n++;
+        pos = p;
+    }
+    return n;
+}
+
+static inline bool get_varint(const uint8_t *d, size_t size, size_t *pos, uint64_t *value) {
+    size_t p = *pos;
+    uint64_t v = 0;
+    int s = 0;
+    for (;;) {
+        if (p == size || s > 63) return false;
+        uint8_t b = d[p++];
+        v |= (uint64_t)(b & 0x7f) << s;
+        if (!(b & 0x80)) break;
+        s += 7;
+    }
+    *value = v;
+    *pos = p;
+    return true;
+}
+
+static inline int64_t unzigzag(uint64_t v) { return (int64_t)(v >> 1) ^ -(int64_t)(v & 1); }
+
+int FileTraceSource::read_binary(trace_record *out, int max) {
+    int n = 0;
+    const uint8_t *d = data;
+    size_t p = pos;
+    while (n < max && remaining > 0) {
+        uint64_t v;
+        if (!get_varint(d, size, &p, &v) || size - p < 4) {
+            error = "truncated binary record";
+            remaining = 0;
+            pos = p;
+            return n;
+        }
+        prev_pc += (uint64_t)unzigzag(v);
+        out[n].pc = prev_pc;
+        out[n].op_type = d[p];
+        out[n].dest = (int)d[p + 1] - 1;
+        out[n].src1 = (int)d[p + 2] - 1;
+        out[n].src2 = (int)d[p + 3] - 1;
+        out[n].mem_addr = 0;
+        out[n].taken = false;
+        p += 4;
+        if (!trace_reg_ok(out[n].dest) || !trace_reg_ok(out[n].src1) || !trace_reg_ok(out[n].src2)) {
+            error = "register out of range";
+            remaining = 0;
+            pos = p;
+            return n;
+        }
+        if (version >= 2 && trace_is_mem_op(out[n].op_type)) {
+            if (!get_varint(d, size, &p, &v)) {
+                error = "truncated binary record";
+                remaining = 0;
+                pos = p;
+                return n;
+            }
+            prev_addr += (uint64_t)unzigzag(v);
+            out[n].mem_addr = prev_addr;
+        }
+        if (version >= 3 && trace_is_branch(out[n].op_type)) {
+            if (p == size) {
+                error = "truncated binary record";
+                remaining = 0;
+                pos = p;
+                return n;
+            }
+            out[n].taken = (d[p++] != 0);
+        }
+        remaining--;
+        n++;
+    }
+    pos = p;
+    return n;
+}
+
+bool load_trace(const char *path, std::vector<trace_record> &records) {
+    FileTraceSource source;
+    if (!source.open(path)) return false;
+    trace_record recs[256];
+    int n;
+    while ((n = source.read(recs, 256)) > 0) records.insert(records.end(), recs, recs + n);
+    return source.error == NULL;
+}
+
+bool TraceWriter::create(const char *path) {
+    out = fopen(path, "wb");
+    if (out == NULL) return false;
+    count = 0;
+    prev_pc = prev_addr = 0;
+    // record count is patched in by finish()
+    memset(buf, 0, PROC_TRACE_HDR_LEN);
+    memcpy(buf, PROC_TRACE_MAGIC_BR, PROC_TRACE_MAGIC_LEN);
+    len = PROC_TRACE_HDR_LEN;
+    return true;
+}
+
+static inline uint64_t zigzag(int64_t v) { return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63); }
+
+void TraceWriter::put_varint(uint64_t v) {
+    while (v >= 0x80) {
+        buf[len++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    buf[len++] = (uint8_t)v;
+}
+
+bool TraceWriter::add(const trace_record &rec) {
+    if (rec.op_type < 0 || rec.op_type > 255) return false;
+    if (!trace_reg_ok(rec.dest) || !trace_reg_ok(rec.src1) || !trace_reg_ok(rec.src2))
+        return false;
+    if (len > sizeof(buf) - 32) {
+        fwrite(buf, 1, len, out);
+        len = 0;
+    }
+    put_varint(zigzag((int64_t)(rec.pc - prev_pc)));
+    buf[len++] = (uint8_t)rec.op_type;
+    buf[len++] = (uint8_t)(rec.dest + 1);
+    buf[len++] = (uint8_t)(rec.src1 + 1);
+    buf[len++] = (uint8_t)(rec.src2 + 1);
+    prev_pc = rec.pc;
+    if (trace_is_mem_op(rec.op_type)) {
+        put_varint(zigzag((int64_t)(rec.mem_addr - prev_addr)));
+        prev_addr = rec.mem_addr;
+    }
+    if (trace_is_branch(rec.op_type)) buf[len++] = rec.taken ? 1 : 0;
+    count++;
+    return true;
+}
+
+bool TraceWriter::finish() {
+    bool ok = (fwrite(buf, 1, len, out) == len);
+    uint8_t hdr[8];
+    for (int i = 0; i < 8; i++) hdr[i] = (uint8_t)(count >> (8 * i));
+    ok &= (fseek(out, PROC_TRACE_MAGIC_LEN, SEEK_SET) == 0);
+    ok &= (fwrite(hdr, 1, 8, out) == 8);
+    ok &= (fclose(out) == 0);
+    return ok;
+}
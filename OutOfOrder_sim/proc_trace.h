@@ -0,0 +1,116 @@
+#ifndef PROC_TRACE_H
+#define PROC_TRACE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <vector>
+
+// Instruction traces.  The file is mmap'd and decoded in bulk; the format is
+// detected from the first bytes:
+//
+//   text:    one "<hex pc> <op type> <dest reg> <src1 reg> <src2 reg>" record
+//            per line (-1 for no register), optionally followed on the same
+//            line by "<hex address>" for a load or store or by "t" or "n"
+//            for a branch; the trace ends at the first record that does not
+//            parse, as it always has
+//   binary:  "OOOTRACE", u64 record count (little endian), then per record
+//            a varint zigzag(pc - previous pc), the op type byte and the
+//            dest/src1/src2 registers as bytes holding reg + 1
+//   binary:  "OOOTRAC2", the same, plus for loads and stores (op types 3
+//            and 4) a varint zigzag(address - previous address)
+//   binary:  "OOOTRAC3", the same, plus for branches (op type 5) a byte
+//            holding 1 if taken
+//
+// Addresses are only kept for loads and stores and outcomes for branches;
+// other records read as address 0, not taken.  Registers are -1 or one of
+// the PROC_TRACE_REGS architectural registers; a record naming any other
+// stops the trace with an error in either format.
+
+#define PROC_TRACE_MAGIC     "OOOTRACE"
+#define PROC_TRACE_MAGIC_MEM "OOOTRAC2"
+#define PROC_TRACE_MAGIC_BR  "OOOTRAC3"
+#define PROC_TRACE_MAGIC_LEN 8
+#define PROC_TRACE_HDR_LEN   16
+#define PROC_TRACE_REGS      67
+
+struct trace_record {
+    uint64_t pc;
+    int op_type;
+    int dest, src1, src2;
+    uint64_t mem_addr;
+    bool taken;
+};
+
+static inline bool trace_is_mem_op(int op_type) { return op_type == 3 || op_type == 4; }
+static inline bool trace_is_branch(int op_type) { return op_type == 5; }
+static inline bool trace_reg_ok(int64_t r) { return r >= -1 && r < PROC_TRACE_REGS; }
+
+// Where Fetch gets its instructions from.  read() fills up to max records
+// and returns how many it produced; fewer than max means the trace ended.
+class TraceSource {
+public:
+    virtual ~TraceSource() {}
+    virtual int read(trace_record *out, int max) = 0;
+};
+
+// Walks a trace already decoded into memory; the records are not copied, so
+// any number of sources can share one array.
+class ArrayTraceSource : public TraceSource {
+public:
+    ArrayTraceSource(const trace_record *records, size_t count) : records(records), count(count), next(0) {}
+    int read(trace_record *out, int max);
+private:
+    const trace_record *records;
+    size_t count, next;
+};
+
+// Text or binary trace file.
+class FileTraceSource : public TraceSource {
+public:
+    FileTraceSource();
+    ~FileTraceSource();
+
+    // Returns false if the file cannot be opened.
+    bool open(const char *path);
+    int read(trace_record *out, int max);
+
+    // Reads past up to n records; returns how many there were.
+    size_t skip(size_t n);
+
+    bool binary;
+    const char *error;      // set if a trace is truncated or corrupt
+private:
+    const uint8_t *data;
+    size_t size, pos;
+    int version;            // binary: 1 plain, 2 with addresses, 3 with outcomes
+    uint64_t remaining, prev_pc, prev_addr;
+
+    int read_text(trace_record *out, int max);
+    int read_binary(trace_record *out, int max);
+};
+
+// Decodes a whole trace (either format) into records; returns false if it
+// cannot be opened or is corrupt.
+bool load_trace(const char *path, std::vector<trace_record> &records);
+
+// Binary trace writer; the record count is patched into the header by
+// finish().  Returns false on a write error, or from add() for a record that
+// does not fit the format (op type above 255, register outside
+// -1..PROC_TRACE_REGS - 1).
+class TraceWriter {
+public:
+    bool create(const char *path);
+    bool add(const trace_record &rec);
+    bool finish();
+    uint64_t count;
+private:
+    FILE *out;
+    uint64_t prev_pc, prev_addr;
+    size_t len;
+    uint8_t buf[1 << 16];
+
+    void put_varint(uint64_t v);
+};
+
+#endif
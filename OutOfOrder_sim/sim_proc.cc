@@ -8,391 +8,667 @@
 #include <iomanip>
 #include <climits>
 #include "sim_proc.h"
+#include "proc_sweep.h"
+#include "proc_simpoint.h"
+#include "proc_chunked.h"
+#include "proc_limits.h"
 
 using namespace std;
 
-struct instruction {
-    uint64_t pc;
-    int op_type;
-    int dest, src1, src2;
-    int seq_num;
-    int dest_tag;
-    int src1_tag, src2_tag;
-    bool src1_ready, src2_ready;
-
-    int fe_begin, fe_duration;
-    int de_begin, de_duration;
-    int rn_begin, rn_duration;
-    int rr_begin, rr_duration;
-    int di_begin, di_duration;
-    int is_begin, is_duration;
-    int ex_begin, ex_duration;
-    int wb_begin, wb_duration;
-    int rt_begin, rt_duration;
-
-    int exec_timer;
-    int exec_latency;
-
-    instruction() {
-        pc = 0;
-        op_type = 0;
-        dest = src1 = src2 = -1;
-        seq_num = -1;
-        dest_tag = src1_tag = src2_tag = -1;
-        src1_ready = src2_ready = false;
-
-        fe_begin = fe_duration = -1;
-        de_begin = de_duration = -1;
-        rn_begin = rn_duration = -1;
-        rr_begin = rr_duration = -1;
-        di_begin = di_duration = -1;
-        is_begin = is_duration = -1;
-        ex_begin = ex_duration = -1;
-        wb_begin = wb_duration = -1;
-        rt_begin = rt_duration = -1;
-
-        exec_timer = 0;
-        exec_latency = 0;
+Processor::Processor(const proc_params &params, TraceSource *source, bool print_timing)
+    : source(source), print_timing(print_timing) {
+    ROB_SIZE = (int)params.rob_size;
+    IQ_SIZE = (int)params.iq_size;
+    WIDTH = (int)params.width;
+    fu = params.fu;
+    memory = params.mem ? new MemorySystem(*params.mem) : NULL;
+    predictor = params.br ? new BranchPredictor(params.br->bp) : NULL;
+    bp_penalty = params.br ? params.br->penalty : 0;
+    fetch_resume_cycle = 0;
+    mispredict_seq = mispredict_fetch_cycle = -1;
+    branches = mispredictions = mispredict_cycles = 0;
+    lsq_size = params.mem ? params.mem->lsq_size : 0;
+    lsq_count = 0;
+    lsq_blocked = false;
+    lsq_full_cycles = 0;
+
+    current_cycle = 0;
+    retired_count = 0;
+    instruction_counter = 0;
+    trace_done = false;
+    source_done = false;
+    drained = false;
+
+    rob_head = rob_tail = rob_count = 0;
+    seq.assign(ROB_SIZE, -1);
+    op.assign(ROB_SIZE, 0);
+    dest.assign(ROB_SIZE, -1);
+    ready.assign(ROB_SIZE, 0);
+    src1_tag.assign(ROB_SIZE, -1);
+    src2_tag.assign(ROB_SIZE, -1);
+    src1_ready.assign(ROB_SIZE, 0);
+    src2_ready.assign(ROB_SIZE, 0);
+    mem_tag.assign(ROB_SIZE, -1);
+    mem_ready.assign(ROB_SIZE, 1);
+    mem_addr.assign(ROB_SIZE, 0);
+    in_iq.assign(ROB_SIZE, 0);
+    done_cycle.assign(ROB_SIZE, -1);
+    fu_unit.assign(ROB_SIZE, -1);
+    mem_miss.assign(ROB_SIZE, 0);
+    consumers.resize(ROB_SIZE);
+    timing.resize(ROB_SIZE);
+
+    front.resize(2 * WIDTH);
+    front_head = rn_count = de_count = 0;
+    rr_first = rr_count = di_first = di_count = 0;
+    WB.reserve(ROB_SIZE);
+    for (int i = 0; i < PROC_TRACE_REGS; i++) rename_table[i] = -1;
+
+    iq_ready.assign((ROB_SIZE + 63) / 64, 0);
+    iq_count = 0;
+
+    int max_latency = fu ? fu->max_latency : 0;
+    for (int op = 0; op <= 2; op++)
+        if (get_latency(op) > max_latency) max_latency = get_latency(op);
+    if (memory) max_latency += memory->max_latency();
+    int wheel_size = 1;
+    while (wheel_size <= max_latency) wheel_size <<= 1;
+    ex_wheel.resize(wheel_size);
+    ex_wheel_mask = wheel_size - 1;
+    ex_count = 0;
+
+    unit_busy = 0;
+    if (fu) {
+        issue_cand.resize(iq_ready.size());
+        fu_stats.assign(fu->classes.size(), fu_stat());
     }
-};
 
-struct rob_entry {
-    bool valid, ready;
-    int dest_reg;
-    instruction *inst;
-    rob_entry() {
-        valid = false;
-        ready = false;
-        dest_reg = -1;
-        inst = NULL;
+    fetch_buf.resize(WIDTH);
+    fetch_len = 0;
+
+    if (print_timing) out_buf.resize(1 << 16);
+    out_len = 0;
+
+    timing_log = NULL;
+    stats = NULL;
+    if (params.stats) {
+        stats = new proc_stats();
+        stats->rob_hist.assign(ROB_SIZE + 1, 0);
+        stats->iq_hist.assign(IQ_SIZE + 1, 0);
     }
-};
+}
 
-int current_cycle = 0;
-int instruction_counter = 0;
+Processor::~Processor() {
+    delete memory;
+    delete predictor;
+    delete stats;
+}
 
-vector<instruction*> DE, RN, RR, DI, IQ, EX_list, WB;
-vector<rob_entry> ROB;
-int rob_head = 0, rob_tail = 0, rob_count = 0;
+void Processor::flush_output() {
+    cout.write(&out_buf[0], out_len);
+    out_len = 0;
+}
 
-int rename_table[67];
+static inline char *put_int(char *p, int v) {
+    char tmp[12];
+    int n = 0;
+    unsigned int u = (v < 0) ? 0U - (unsigned int)v : (unsigned int)v;
+    if (v < 0) *p++ = '-';
+    do {
+        tmp[n++] = (char)('0' + u % 10);
+        u /= 10;
+    } while (u);
+    while (n) *p++ = tmp[--n];
+    return p;
+}
 
-int ROB_SIZE, IQ_SIZE, WIDTH;
+static inline char *put_str(char *p, const char *s) {
+    while (*s) *p++ = *s++;
+    return p;
+}
 
-ifstream trace;
-bool trace_done = false;
-vector<instruction*> completed;
+static inline char *put_stage(char *p, const char *name, int begin, int dur) {
+    p = put_str(p, name);
+    *p++ = '{';
+    if (begin != -1 && dur != -1) {
+        p = put_int(p, begin);
+        *p++ = ',';
+        p = put_int(p, dur);
+    } else {
+        p = put_str(p, "0,0");
+    }
+    *p++ = '}';
+    return p;
+}
 
+static const char *stage_names[NUM_STAGES] = { "FE", "DE", "RN", "RR", "DI", "IS", "EX", "WB", "RT" };
+
+char *put_timing_line(char *p, const inst_timing *t) {
+    p = put_int(p, t->seq_num);
+    p = put_str(p, " fu{");
+    p = put_int(p, t->op_type);
+    p = put_str(p, "} src{");
+    p = put_int(p, t->src1);
+    *p++ = ',';
+    p = put_int(p, t->src2);
+    p = put_str(p, "} dst{");
+    p = put_int(p, t->dest);
+    *p++ = '}';
+    for (int st = 0; st < NUM_STAGES; st++) {
+        *p++ = ' ';
+        p = put_stage(p, stage_names[st], t->begin[st], t->duration[st]);
+    }
+    *p++ = '\n';
+    return p;
+}
+
+// One timing line per instruction, in retirement order.
+void Processor::write_retired(const inst_timing *t) {
+    if (out_len > out_buf.size() - TIMING_LINE_MAX) flush_output();
+    char *p = put_timing_line(&out_buf[out_len], t);
+    out_len = (size_t)(p - &out_buf[0]);
+}
 
+// Operand readiness exactly as Issue has always judged it: a woken operand,
+// or whatever instruction currently owns the source tag's ROB slot being
+// ready.  The latter can turn false again when the slot is reallocated.
+void Processor::update_issue_ready(int slot) {
+    if (!in_iq[slot]) return;
+    bool ready1 = src1_ready[slot] || (src1_tag[slot] != -1 && ready[src1_tag[slot]]);
+    bool ready2 = src2_ready[slot] || (src2_tag[slot] != -1 && ready[src2_tag[slot]]);
+    uint64_t bit = 1ULL << (slot & 63);
+    if (ready1 && ready2 && mem_ready[slot]) iq_ready[slot >> 6] |= bit;
+    else iq_ready[slot >> 6] &= ~bit;
+}
 
-inline int get_latency(int op) {
-    switch(op) {
-        case 0: return 1;
-        case 1: return 2;
-        case 2: return 5;
-        default: return 1;  
+// Re-evaluates the IQ entries that still wait on tag after its slot's ready
+// bit changed.
+void Processor::update_consumers_ready(int tag) {
+    for (const wakeup_ref &ref : consumers[tag])
+        if (seq[ref.slot] == ref.seq_num) update_issue_ready(ref.slot);
+}
+
+// Oldest ROB slot set in ready (a bitmap shaped like iq_ready), or -1.
+int Processor::find_oldest_ready(const vector<uint64_t> &candidates) {
+    int words = (int)candidates.size();
+    int w = rob_head >> 6;
+    uint64_t bits = candidates[w] & (~0ULL << (rob_head & 63));
+    for (int i = 0; i <= words; i++) {
+        if (bits) return (w << 6) + __builtin_ctzll(bits);
+        w = (w + 1 == words) ? 0 : w + 1;
+        bits = candidates[w];
     }
+    return -1;
 }
 
-/********************** FETCH *************************/
+/********************** STALL ACCOUNTING *************************/
 
-void Fetch() {
-    
-    if (trace_done || !DE.empty()) return;
+// Each stage's early-out as a stall_reason, or -1 if the stage is idle or
+// can act.  They only read state, so a stage may ask before it runs.
+int Processor::fetch_stall() {
+    if (trace_done) return STALL_TRACE_DONE;
+    if (current_cycle < fetch_resume_cycle) return STALL_REDIRECT;
+    if (de_count) return STALL_DE_BUSY;
+    return -1;
+}
 
-    
-    for (int fetch_idx = 0; fetch_idx < WIDTH; fetch_idx++) {
-        uint64_t pc;
-        int op, dst, s1, s2;
-        
-        
-        if (!(trace >> hex >> pc >> dec >> op >> dst >> s1 >> s2)) {
-            trace_done = true;
-            break;
-        }
+int Processor::decode_stall() {
+    return (de_count && rn_count) ? STALL_RN_BUSY : -1;
+}
 
-        
-        instruction *new_inst = new instruction();
-        new_inst->pc = pc;
-        new_inst->op_type = op;
-        new_inst->dest = dst;
-        new_inst->src1 = s1;
-        new_inst->src2 = s2;
-        new_inst->seq_num = instruction_counter++;
+int Processor::rename_stall() {
+    if (rn_count == 0) return -1;
+    if (rr_count) return STALL_RR_BUSY;
+    if (rob_count + rn_count > ROB_SIZE) return STALL_ROB_FULL;
+    return -1;
+}
 
-        
-        new_inst->fe_begin = current_cycle;
-        new_inst->fe_duration = 1;
+int Processor::regread_stall() {
+    return (rr_count && di_count) ? STALL_DI_BUSY : -1;
+}
+
+int Processor::dispatch_stall() {
+    if (di_count == 0) return -1;
+    if (IQ_SIZE - iq_count < di_count) return STALL_IQ_FULL;
+    return can_dispatch() ? -1 : STALL_LSQ_FULL;
+}
+
+// Only meaningful when Issue issued nothing this cycle.
+int Processor::issue_stall() {
+    if (iq_count == 0) return -1;
+    for (uint64_t bits : iq_ready) if (bits) return STALL_STRUCTURAL;
+    return STALL_NOT_READY;
+}
+
+// What holds up the ROB head in a cycle Retire commits nothing.
+int Processor::cpi_category() {
+    if (rob_count == 0 || (!in_iq[rob_head] && done_cycle[rob_head] == -1))
+        return current_cycle < fetch_resume_cycle ? CPI_BRANCH : CPI_FRONTEND;
+    if (in_iq[rob_head])
+        return (iq_ready[rob_head >> 6] >> (rob_head & 63)) & 1 ? CPI_STRUCTURAL : CPI_DEPENDENCY;
+    return mem_miss[rob_head] ? CPI_MEMORY : CPI_EXECUTE;
+}
+
+void Processor::count_stall(int reason, unsigned long int cycles) {
+    if (reason >= 0) stats->stalls[reason] += cycles;
+}
+
+// Charges cycles that Advance_Cycle skips: the pipeline stays exactly as it
+// is now, so every stage would stall the same way each cycle.
+void Processor::count_skipped(unsigned long int cycles) {
+    count_stall(fetch_stall(), cycles);
+    count_stall(decode_stall(), cycles);
+    count_stall(rename_stall(), cycles);
+    count_stall(regread_stall(), cycles);
+    count_stall(dispatch_stall(), cycles);
+    count_stall(issue_stall(), cycles);
+    stats->cpi[cpi_category()] += cycles;
+    stats->rob_hist[rob_count] += cycles;
+    stats->iq_hist[iq_count] += cycles;
+}
+
+/********************** FETCH *************************/
+
+void Processor::Fetch() {
+    if (stats) count_stall(fetch_stall(), 1);
+    
+    if (trace_done || de_count) return;
+    if (current_cycle < fetch_resume_cycle) return;
 
-        new_inst->de_begin = new_inst->fe_begin + new_inst->fe_duration;
+    
+    // a group cut short behind a mispredicted branch leaves the rest of the
+    // records in fetch_buf for the next fetch
+    if (!source_done && fetch_len < WIDTH) {
+        int want = WIDTH - fetch_len;
+        int got = source->read(&fetch_buf[fetch_len], want);
+        if (got < want) source_done = true;
+        fetch_len += got;
+    }
 
-        DE.push_back(new_inst);
+    int front_size = (int)front.size();
+    int fetch_idx = 0;
+    while (fetch_idx < fetch_len) {
+        const trace_record &rec = fetch_buf[fetch_idx++];
+
+        
+        int pos = front_head + rn_count + de_count;
+        if (pos >= front_size) pos -= front_size;
+        fetched_inst &f = front[pos];
+        f.rec = rec;
+        inst_timing &t = f.timing;
+        t.seq_num = instruction_counter++;
+        t.op_type = rec.op_type;
+        t.dest = rec.dest;
+        t.src1 = rec.src1;
+        t.src2 = rec.src2;
+        for (int st = 0; st < NUM_STAGES; st++) t.begin[st] = t.duration[st] = -1;
+
+        
+        t.begin[ST_FE] = current_cycle;
+        t.duration[ST_FE] = 1;
+
+        t.begin[ST_DE] = t.begin[ST_FE] + t.duration[ST_FE];
+
+        de_count++;
+
+        if (predictor && trace_is_branch(rec.op_type)) {
+            bp_lookup l;
+            int prediction = predictor->predict(rec.pc, &l);
+            predictor->update(l, rec.taken);
+            predictor->update_history(rec.taken);
+            branches++;
+            if (prediction != (int)rec.taken) {
+                mispredictions++;
+                mispredict_seq = t.seq_num;
+                mispredict_fetch_cycle = current_cycle;
+                fetch_resume_cycle = INT_MAX;
+                break;
+            }
+        }
     }
+    fetch_len -= fetch_idx;
+    for (int i = 0; i < fetch_len; i++) fetch_buf[i] = fetch_buf[fetch_idx + i];
+    if (source_done && fetch_len == 0) trace_done = true;
 }
 
 /********************** DECODE *************************/
 
-void Decode() {
+void Processor::Decode() {
+    if (stats) count_stall(decode_stall(), 1);
     
-    if (DE.empty() || !RN.empty()) return;
+    if (de_count == 0 || rn_count) return;
 
     
-    for (instruction *dec_inst : DE) {
-        dec_inst->de_duration = (current_cycle - dec_inst->de_begin) + 1;
-        dec_inst->rn_begin = dec_inst->de_begin + dec_inst->de_duration;
-        RN.push_back(dec_inst);
+    // the DE group already follows RN in the ring, so it only changes hands
+    int front_size = (int)front.size();
+    for (int i = 0; i < de_count; i++) {
+        int pos = front_head + i;
+        if (pos >= front_size) pos -= front_size;
+        inst_timing &t = front[pos].timing;
+        t.duration[ST_DE] = (current_cycle - t.begin[ST_DE]) + 1;
+        t.begin[ST_RN] = t.begin[ST_DE] + t.duration[ST_DE];
     }
-    DE.clear();
+    rn_count = de_count;
+    de_count = 0;
 }
 
 /********************** RENAME *************************/
 
-void Rename() {
-    if (RN.empty() || !RR.empty()) return;
+void Processor::Rename() {
+    if (stats) count_stall(rename_stall(), 1);
+    if (rn_count == 0 || rr_count) return;
     
     
-    if (rob_count + (int)RN.size() > ROB_SIZE) return;
+    if (rob_count + rn_count > ROB_SIZE) return;
 
     
-    for (instruction *rename_inst : RN) {
-        rename_inst->rn_duration = (current_cycle - rename_inst->rn_begin) + 1;
+    int front_size = (int)front.size();
+    rr_first = rob_tail;
+    for (int i = 0; i < rn_count; i++) {
+        const fetched_inst &f = front[front_head];
+        front_head = (front_head + 1 == front_size) ? 0 : front_head + 1;
+        int slot = rob_tail;
 
         
-        rename_inst->dest_tag = rob_tail;
+        inst_timing &t = timing[slot];
+        t = f.timing;
+        t.duration[ST_RN] = (current_cycle - t.begin[ST_RN]) + 1;
 
         
-        ROB[rob_tail].valid = true;
-        ROB[rob_tail].ready = false;  
-        ROB[rob_tail].dest_reg = rename_inst->dest;
-        ROB[rob_tail].inst = rename_inst;
+        seq[slot] = t.seq_num;
+        op[slot] = f.rec.op_type;
+        dest[slot] = f.rec.dest;
+        mem_addr[slot] = f.rec.mem_addr;
+        mem_tag[slot] = -1;
+        mem_ready[slot] = 1;
+        in_iq[slot] = 0;
+        done_cycle[slot] = -1;
+        fu_unit[slot] = -1;
+        mem_miss[slot] = 0;
+        ready[slot] = 0;  
+        update_consumers_ready(slot);
 
         
         rob_tail = (rob_tail + 1) % ROB_SIZE;
         rob_count++;
 
         
-        if (rename_inst->src1 != -1) {
-            rename_inst->src1_tag = rename_table[rename_inst->src1];
+        int tag1 = -1, tag2 = -1;
+        if (f.rec.src1 != -1) {
+            tag1 = rename_table[f.rec.src1];
             
-            rename_inst->src1_ready = (rename_inst->src1_tag == -1) || 
-                                      ROB[rename_inst->src1_tag].ready;
+            src1_ready[slot] = (tag1 == -1) || ready[tag1];
         } else {
-            rename_inst->src1_tag = -1;
-            rename_inst->src1_ready = true;
+            src1_ready[slot] = 1;
         }
+        src1_tag[slot] = tag1;
 
         
-        if (rename_inst->src2 != -1) {
-            rename_inst->src2_tag = rename_table[rename_inst->src2];
+        if (f.rec.src2 != -1) {
+            tag2 = rename_table[f.rec.src2];
             
-            rename_inst->src2_ready = (rename_inst->src2_tag == -1) || 
-                                      ROB[rename_inst->src2_tag].ready;
+            src2_ready[slot] = (tag2 == -1) || ready[tag2];
         } else {
-            rename_inst->src2_tag = -1;
-            rename_inst->src2_ready = true;
+            src2_ready[slot] = 1;
+        }
+        src2_tag[slot] = tag2;
+
+        
+        if (tag1 != -1)
+            consumers[tag1].push_back({slot, t.seq_num});
+        if (tag2 != -1 && tag2 != tag1)
+            consumers[tag2].push_back({slot, t.seq_num});
+
+        // store_tags only holds stores still in the ROB; one whose Execute
+        // has already completed cannot wake the load any more
+        if (memory && f.rec.op_type == OP_LOAD) {
+            auto it = store_tags.find(f.rec.mem_addr >> 3);
+            if (it != store_tags.end()) {
+                int store = it->second;
+                mem_tag[slot] = store;
+                mem_ready[slot] = (done_cycle[store] != -1 && done_cycle[store] <= current_cycle);
+                if (!mem_ready[slot] && store != tag1 && store != tag2)
+                    consumers[store].push_back({slot, t.seq_num});
+            }
+        } else if (memory && f.rec.op_type == OP_STORE) {
+            store_tags[f.rec.mem_addr >> 3] = slot;
         }
 
         
-        if (rename_inst->dest != -1)
-            rename_table[rename_inst->dest] = rename_inst->dest_tag;
+        if (f.rec.dest != -1)
+            rename_table[f.rec.dest] = slot;
 
-        rename_inst->rr_begin = rename_inst->rn_begin + rename_inst->rn_duration;
-        RR.push_back(rename_inst);
+        t.begin[ST_RR] = t.begin[ST_RN] + t.duration[ST_RN];
     }
-    RN.clear();
+    rr_count = rn_count;
+    rn_count = 0;
 }
 
 /********************** REG READ *************************/
 
-void RegRead() {
+void Processor::RegRead() {
+    if (stats) count_stall(regread_stall(), 1);
     
-    if (RR.empty() || !DI.empty()) return;
+    if (rr_count == 0 || di_count) return;
 
     
-    for (instruction *rr_inst : RR) {
-        rr_inst->rr_duration = (current_cycle - rr_inst->rr_begin) + 1;
+    int slot = rr_first;
+    for (int i = 0; i < rr_count; i++) {
+        inst_timing &t = timing[slot];
+        t.duration[ST_RR] = (current_cycle - t.begin[ST_RR]) + 1;
 
         
-        if (rr_inst->src1_tag != -1)
-            rr_inst->src1_ready |= ROB[rr_inst->src1_tag].ready;
-        if (rr_inst->src2_tag != -1)
-            rr_inst->src2_ready |= ROB[rr_inst->src2_tag].ready;
+        if (src1_tag[slot] != -1)
+            src1_ready[slot] |= ready[src1_tag[slot]];
+        if (src2_tag[slot] != -1)
+            src2_ready[slot] |= ready[src2_tag[slot]];
 
-        rr_inst->di_begin = rr_inst->rr_begin + rr_inst->rr_duration;
-        DI.push_back(rr_inst);
+        t.begin[ST_DI] = t.begin[ST_RR] + t.duration[ST_RR];
+        slot = (slot + 1 == ROB_SIZE) ? 0 : slot + 1;
     }
-    RR.clear();
+    di_first = rr_first;
+    di_count = rr_count;
+    rr_count = 0;
 }
 
 /********************** DISPATCH *************************/
 
-void Dispatch() {
-    if (DI.empty()) return;
+// Whether the DI group fits the IQ, and the LSQ with a memory model.
+bool Processor::can_dispatch() {
+    if (IQ_SIZE - iq_count < di_count) return false;
+    lsq_blocked = false;
+    if (memory) {
+        int mem_ops = 0;
+        int slot = di_first;
+        for (int i = 0; i < di_count; i++) {
+            if (trace_is_mem_op(op[slot])) mem_ops++;
+            slot = (slot + 1 == ROB_SIZE) ? 0 : slot + 1;
+        }
+        lsq_blocked = (lsq_count + mem_ops > lsq_size);
+    }
+    return !lsq_blocked;
+}
+
+void Processor::Dispatch() {
+    if (stats) count_stall(dispatch_stall(), 1);
+    lsq_blocked = false;
+    if (di_count == 0) return;
 
     
-    int available_slots = IQ_SIZE - (int)IQ.size();
-    if (available_slots < (int)DI.size()) return;
+    if (!can_dispatch()) {
+        if (lsq_blocked) lsq_full_cycles++;
+        return;
+    }
 
     
-    for (instruction *dispatch_inst : DI) {
-        dispatch_inst->di_duration = (current_cycle - dispatch_inst->di_begin) + 1;
+    int slot = di_first;
+    for (int i = 0; i < di_count; i++) {
+        inst_timing &t = timing[slot];
+        t.duration[ST_DI] = (current_cycle - t.begin[ST_DI]) + 1;
 
         
         
-        if (dispatch_inst->src1_tag != -1)
-            dispatch_inst->src1_ready |= ROB[dispatch_inst->src1_tag].ready;
-        if (dispatch_inst->src2_tag != -1)
-            dispatch_inst->src2_ready |= ROB[dispatch_inst->src2_tag].ready;
+        if (src1_tag[slot] != -1)
+            src1_ready[slot] |= ready[src1_tag[slot]];
+        if (src2_tag[slot] != -1)
+            src2_ready[slot] |= ready[src2_tag[slot]];
 
-        dispatch_inst->is_begin = dispatch_inst->di_begin + dispatch_inst->di_duration;
-        IQ.push_back(dispatch_inst);
+        t.begin[ST_IS] = t.begin[ST_DI] + t.duration[ST_DI];
+        if (memory && trace_is_mem_op(op[slot])) lsq_count++;
+        in_iq[slot] = 1;
+        iq_count++;
+        update_issue_ready(slot);
+        slot = (slot + 1 == ROB_SIZE) ? 0 : slot + 1;
     }
-    DI.clear();
+    di_count = 0;
 }
 
 /********************** ISSUE *************************/
 
-void Issue() {
-    int issued_count = 0;
-    vector<instruction*> remaining_insts;
+void Processor::issue_instruction(int slot, int latency) {
+    inst_timing &t = timing[slot];
+    t.duration[ST_IS] = (current_cycle - t.begin[ST_IS]) + 1;
 
     
-    while (issued_count < WIDTH && !IQ.empty()) {
-        int selected_idx = -1;
-        int oldest_seq = INT_MAX;
-
-        
-        for (int i = 0; i < (int)IQ.size(); i++) {
-            instruction *curr = IQ[i];
-            if (!curr) continue;
+    t.begin[ST_EX] = t.begin[ST_IS] + t.duration[ST_IS];
+    t.duration[ST_EX] = latency;
+    done_cycle[slot] = t.begin[ST_EX] + latency - 1;
 
-            
-            
-            bool operand1_ready = curr->src1_ready;
-            bool operand2_ready = curr->src2_ready;
-            
-            
-            if (curr->src1_tag != -1 && !operand1_ready)
-                operand1_ready = ROB[curr->src1_tag].ready;
-            if (curr->src2_tag != -1 && !operand2_ready)
-                operand2_ready = ROB[curr->src2_tag].ready;
-
-            
-            if (operand1_ready && operand2_ready) {
-                if (curr->seq_num < oldest_seq) {
-                    oldest_seq = curr->seq_num;
-                    selected_idx = i;
-                }
-            }
-        }
+    ex_wheel[done_cycle[slot] & ex_wheel_mask].push_back(slot);
+    ex_count++;
 
-        
-        if (selected_idx == -1) break;
+    iq_ready[slot >> 6] &= ~(1ULL << (slot & 63));
+    in_iq[slot] = 0;
+    iq_count--;
+}
 
-        
-        instruction *issue_inst = IQ[selected_idx];
-        issue_inst->is_duration = (current_cycle - issue_inst->is_begin) + 1;
+void Processor::Issue() {
+    if (fu || memory) {
+        Issue_constrained();
+        return;
+    }
 
-        
-        issue_inst->ex_begin = issue_inst->is_begin + issue_inst->is_duration;
-        issue_inst->exec_latency = get_latency(issue_inst->op_type);
-        issue_inst->exec_timer = issue_inst->exec_latency;
-        issue_inst->ex_duration = issue_inst->exec_latency;
+    int issued_count = 0;
 
-        EX_list.push_back(issue_inst);
+    
+    while (issued_count < WIDTH) {
+        int selected_slot = find_oldest_ready(iq_ready);
+        if (selected_slot == -1) break;
 
-        IQ[selected_idx] = NULL;
+        issue_instruction(selected_slot, get_latency(op[selected_slot]));
         issued_count++;
     }
-
-    
-    for (instruction *curr : IQ)
-        if (curr) remaining_insts.push_back(curr);
-
-    IQ.swap(remaining_insts);
+    if (stats && issued_count == 0) count_stall(issue_stall(), 1);
 }
-/********************** EXECUTE *************************/
 
-void Execute() {
-    vector<instruction*> still_executing;
-    vector<instruction*> completed_execution;
+// Oldest first, skipping ready instructions that cannot take a unit or, for
+// a load that misses, an MSHR this cycle.
+void Processor::Issue_constrained() {
+    int issued_count = 0;
+    uint64_t port_used = 0;     // units whose port has issued this cycle
+    issue_cand = iq_ready;
+
+    while (issued_count < WIDTH) {
+        int slot = find_oldest_ready(issue_cand);
+        if (slot == -1) break;
+        issue_cand[slot >> 6] &= ~(1ULL << (slot & 63));
+
+        int c = -1, unit = -1;
+        uint64_t avail = 0;
+        int latency = get_latency(op[slot]);
+        if (fu) {
+            c = fu->class_of(op[slot]);
+            uint64_t idle = fu->classes[c].units & ~unit_busy;
+            avail = idle & ~port_used;
+            if (!avail) {
+                if (idle) fu_stats[c].port_conflicts++;
+                else fu_stats[c].unit_busy++;
+                continue;
+            }
+            latency = fu->latency_of(op[slot]);
+        }
 
-    
-    for (instruction *ex_inst : EX_list) {
-        
-        if (ex_inst->ex_begin > current_cycle) {
-            still_executing.push_back(ex_inst);
-            continue;
+        // the access starts once the address is computed
+        if (memory && op[slot] == OP_LOAD) {
+            int mem_latency;
+            if (mem_tag[slot] != -1) {
+                mem_latency = memory->params.l1_latency;
+                memory->forwarded++;
+            } else {
+                mem_latency = memory->load(mem_addr[slot], current_cycle, current_cycle + 1 + latency);
+                if (mem_latency < 0) continue;
+            }
+            latency += mem_latency;
+            mem_miss[slot] = mem_latency > memory->params.l1_latency;
         }
 
-        
-        ex_inst->exec_timer--;
-        
-        if (ex_inst->exec_timer <= 0) {
-            
-            completed_execution.push_back(ex_inst);
-        } else {
-            
-            still_executing.push_back(ex_inst);
+        if (fu) {
+            const fu_class &cls = fu->classes[c];
+            unit = __builtin_ctzll(avail);
+            port_used |= fu->port_units[fu->unit_port[unit]];
+            if (!cls.pipelined) unit_busy |= 1ULL << unit;
+            fu_unit[slot] = unit;
+            fu_stats[c].issued++;
+            fu_stats[c].busy_cycles += cls.pipelined ? 1 : latency;
         }
-    }
 
-    EX_list.swap(still_executing);
+        issue_instruction(slot, latency);
+        issued_count++;
+    }
+    if (stats && issued_count == 0) count_stall(issue_stall(), 1);
+}
+/********************** EXECUTE *************************/
 
+void Processor::Execute() {
+    completed_execution.clear();
+    completed_execution.swap(ex_wheel[current_cycle & ex_wheel_mask]);
+    ex_count -= (int)completed_execution.size();
     
-    for (instruction *done_inst : completed_execution) {
-        done_inst->wb_begin = done_inst->ex_begin + done_inst->ex_duration;
-        WB.push_back(done_inst);
-
-        int produced_tag = done_inst->dest_tag;
-
-        
-        for (instruction *waiting_inst : IQ) {
-            if (!waiting_inst) continue;
-            if (produced_tag >= 0 && waiting_inst->src1_tag == produced_tag) 
-                waiting_inst->src1_ready = true;
-            if (produced_tag >= 0 && waiting_inst->src2_tag == produced_tag) 
-                waiting_inst->src2_ready = true;
-        }
-
-        
-        for (instruction *di_inst : DI) {
-            if (produced_tag >= 0 && di_inst->src1_tag == produced_tag) 
-                di_inst->src1_ready = true;
-            if (produced_tag >= 0 && di_inst->src2_tag == produced_tag) 
-                di_inst->src2_ready = true;
+    for (int slot : completed_execution) {
+        inst_timing &t = timing[slot];
+        t.begin[ST_WB] = t.begin[ST_EX] + t.duration[ST_EX];
+        WB.push_back(slot);
+        if (fu_unit[slot] >= 0) unit_busy &= ~(1ULL << fu_unit[slot]);
+        if (seq[slot] == mispredict_seq) {
+            fetch_resume_cycle = current_cycle + 1 + bp_penalty;
+            mispredict_cycles += fetch_resume_cycle - (mispredict_fetch_cycle + 1);
+            mispredict_seq = -1;
         }
 
         
-        for (instruction *rr_inst : RR) {
-            if (produced_tag >= 0 && rr_inst->src1_tag == produced_tag) 
-                rr_inst->src1_ready = true;
-            if (produced_tag >= 0 && rr_inst->src2_tag == produced_tag) 
-                rr_inst->src2_ready = true;
+        // wake exactly the instructions that named this tag; a consumer that
+        // has already issued ignores its ready bits, so waking it is harmless
+        vector<wakeup_ref> &waiting = consumers[slot];
+        for (const wakeup_ref &ref : waiting) {
+            int w = ref.slot;
+            if (seq[w] != ref.seq_num) continue;
+            if (src1_tag[w] == slot) 
+                src1_ready[w] = 1;
+            if (src2_tag[w] == slot) 
+                src2_ready[w] = 1;
+            if (mem_tag[w] == slot)
+                mem_ready[w] = 1;
+            update_issue_ready(w);
         }
+        waiting.clear();
     }
 }
 
 /********************** WRITEBACK *************************/
 
-void Writeback() {
+void Processor::Writeback() {
     if (WB.empty()) return;
 
     
-    for (instruction *wb_inst : WB) {
-        wb_inst->wb_duration = (current_cycle - wb_inst->wb_begin) + 1;
+    for (int slot : WB) {
+        inst_timing &t = timing[slot];
+        t.duration[ST_WB] = (current_cycle - t.begin[ST_WB]) + 1;
 
-        int rob_tag = wb_inst->dest_tag;
-        
-        
-        if (rob_tag >= 0 && rob_tag < ROB_SIZE) {
-            ROB[rob_tag].ready = true;
-            
+        ready[slot] = 1;
+        update_consumers_ready(slot);
             
-            if (wb_inst->rt_begin == -1) {
-                wb_inst->rt_begin = wb_inst->wb_begin + wb_inst->wb_duration;
-            }
-        }
+        if (t.begin[ST_RT] == -1)
+            t.begin[ST_RT] = t.begin[ST_WB] + t.duration[ST_WB];
     }
 
     WB.clear();
@@ -400,145 +676,330 @@ void Writeback() {
 
 /********************** RETIRE *************************/
 
-void Retire() {
+void Processor::Retire() {
     int num_retired = 0;
     
     
     while (num_retired < WIDTH && rob_count > 0) {
-        rob_entry &current_entry = ROB[rob_head];
-        
-        
-        if (!current_entry.valid || !current_entry.ready) 
+        int slot = rob_head;
+        if (!ready[slot]) 
             break;
 
-        instruction *retiring_inst = current_entry.inst;
+        inst_timing &t = timing[slot];
 
         
-        retiring_inst->rt_duration = (current_cycle - retiring_inst->rt_begin) + 1;
+        t.duration[ST_RT] = (current_cycle - t.begin[ST_RT]) + 1;
 
         
-        if (retiring_inst->dest != -1) {
-            if (rename_table[retiring_inst->dest] == rob_head) {
-                rename_table[retiring_inst->dest] = -1;
+        if (dest[slot] != -1) {
+            if (rename_table[dest[slot]] == slot) {
+                rename_table[dest[slot]] = -1;
             }
         }
 
         
-        current_entry.valid = false;
-        
-        
-        
-        current_entry.dest_reg = -1;
-        current_entry.inst = NULL;
+        if (memory && trace_is_mem_op(op[slot])) {
+            lsq_count--;
+            if (op[slot] == OP_STORE) {
+                memory->store(mem_addr[slot]);
+                auto it = store_tags.find(mem_addr[slot] >> 3);
+                if (it != store_tags.end() && it->second == slot) store_tags.erase(it);
+            }
+        }
+
+        // a stale wakeup reference to this slot must not match its next use
+        seq[slot] = -1;
 
         
         rob_head = (rob_head + 1) % ROB_SIZE;
         rob_count--;
 
-        completed.push_back(retiring_inst);
+        if (print_timing) write_retired(&t);
+        if (timing_log) {
+            retired_timing r;
+            r.fe_begin = t.begin[ST_FE];
+            for (int st = 0; st < NUM_STAGES; st++) r.duration[st] = t.duration[st];
+            timing_log->push_back(r);
+        }
+        retired_count++;
         num_retired++;
     }
+    if (stats) stats->cpi[num_retired ? CPI_BASE : cpi_category()]++;
 }
 
 /********************** ADVANCE CYCLE *************************/
 
-bool Advance_Cycle() {
+// True when no stage can act in current_cycle except by an execution
+// completing: each condition below is the early-out of one stage.
+bool Processor::pipeline_quiescent() {
+    if (rob_count > 0 && ready[rob_head]) return false;
+    if (!WB.empty()) return false;
+    for (uint64_t bits : iq_ready) if (bits) return false;
+    if (di_count && can_dispatch()) return false;
+    if (rr_count && !di_count) return false;
+    if (rn_count && !rr_count && rob_count + rn_count <= ROB_SIZE) return false;
+    if (de_count && !rn_count) return false;
+    if (!trace_done && !de_count && current_cycle >= fetch_resume_cycle) return false;
+    return true;
+}
+
+bool Processor::Advance_Cycle() {
+    if (stats) {
+        stats->rob_hist[rob_count]++;
+        stats->iq_hist[iq_count]++;
+    }
     current_cycle++;
     
-    if (rob_count == 0 && DE.empty() && RN.empty() && RR.empty() &&
-        DI.empty() && IQ.empty() && EX_list.empty() && WB.empty() && trace_done)
+    if (rob_count == 0 && !de_count && !rn_count && !rr_count &&
+        !di_count && iq_count == 0 && ex_count == 0 && WB.empty() && trace_done)
         return false;
 
+    
+    // nothing changes until the next completion, so skip straight to it
+    if (ex_count > 0 && pipeline_quiescent()) {
+        int to = current_cycle;
+        while (ex_wheel[to & ex_wheel_mask].empty() && to != fetch_resume_cycle)
+            to++;
+        if (stats && to > current_cycle) count_skipped(to - current_cycle);
+        // each skipped cycle would have found the DI group still blocked
+        if (lsq_blocked) lsq_full_cycles += to - current_cycle;
+        current_cycle = to;
+    }
+
     return true;
 }
+void Processor::run() {
+    run_until(ULONG_MAX);
+    if (print_timing) flush_output();
+}
+
+void Processor::run_until(unsigned long int retired) {
+    while (!drained && retired_count < retired) {
+        Retire();      
+        Writeback();   
+        Execute();     
+        Issue();       
+        Dispatch();    
+        RegRead();     
+        Rename();      
+        Decode();      
+        Fetch();       
+        drained = !Advance_Cycle();
+    }
+}
+
+void Processor::warm(const trace_record &rec) {
+    if (predictor && trace_is_branch(rec.op_type)) {
+        bp_lookup l;
+        predictor->predict(rec.pc, &l);
+        predictor->update(l, rec.taken);
+        predictor->update_history(rec.taken);
+    }
+    if (memory && trace_is_mem_op(rec.op_type))
+        memory->warm(rec.mem_addr, rec.op_type == OP_STORE);
+}
+
+static const char *stall_names[NUM_STALLS] = {
+    "fetch, trace exhausted", "fetch, branch redirect", "fetch, DE occupied",
+    "decode, RN occupied", "rename, RR occupied", "rename, ROB full",
+    "regread, DI occupied", "dispatch, IQ full", "dispatch, LSQ full",
+    "issue, no ready operands", "issue, structural",
+};
+
+static const char *cpi_names[NUM_CPI] = {
+    "base", "front end", "branch", "dependency", "structural", "execute", "memory",
+};
+
+// An occupancy histogram in at most 8 equal bins, as a share of all cycles.
+static void print_histogram(const char *name, const vector<unsigned long int> &hist, int cycles) {
+    int size = (int)hist.size() - 1;
+    double sum = 0;
+    for (int n = 0; n <= size; n++) sum += (double)n * hist[n];
+    cout << "# " << left << setw(29) << (string(name) + " occupancy, mean") << right << "= "
+         << (cycles ? sum / cycles : 0.0) << " of " << size << endl;
+    int bin = (size + 1 + 7) / 8;
+    for (int lo = 0; lo <= size; lo += bin) {
+        int hi = min(lo + bin - 1, size);
+        unsigned long int count = 0;
+        for (int n = lo; n <= hi; n++) count += hist[n];
+        string range = "  " + to_string(lo) + (hi > lo ? "-" + to_string(hi) : "");
+        cout << "# " << left << setw(29) << range << right << "= "
+             << (cycles ? (double)count / cycles * 100 : 0.0) << "%" << endl;
+    }
+}
+
+static void print_stats(const proc_stats &st, int cycles, unsigned long int retired) {
+    cout << "# --- Stall cycles ---------------\n";
+    for (int r = 0; r < NUM_STALLS; r++)
+        cout << "# " << left << setw(29) << stall_names[r] << right << "= " << st.stalls[r] << endl;
+    cout << "# --- CPI stack ------------------\n";
+    for (int c = 0; c < NUM_CPI; c++)
+        cout << "# " << left << setw(29) << cpi_names[c] << right << "= "
+             << (retired ? (double)st.cpi[c] / retired : 0.0) << endl;
+    unsigned long int total = 0;
+    for (int c = 0; c < NUM_CPI; c++) total += st.cpi[c];
+    cout << "# " << left << setw(29) << "total (CPI)" << right << "= "
+         << (retired ? (double)total / retired : 0.0) << endl;
+    cout << "# --- Occupancy ------------------\n";
+    print_histogram("ROB", st.rob_hist, cycles);
+    print_histogram("IQ", st.iq_hist, cycles);
+}
+
 int main(int argc, char* argv[]) {
     ios::sync_with_stdio(false);
     cin.tie(nullptr);
 
-    if (argc != 5) {
-        cerr << "Usage: " << argv[0] << " <ROB_SIZE> <IQ_SIZE> <WIDTH> <tracefile>\n";
+    if (argc >= 2 && strcmp(argv[1], "sweep") == 0)
+        return run_sweep(argc, argv);
+    if (argc >= 2 && strcmp(argv[1], "simpoint") == 0)
+        return run_simpoint(argc, argv);
+    if (argc >= 2 && strcmp(argv[1], "chunked") == 0)
+        return run_chunked(argc, argv);
+    if (argc >= 2 && strcmp(argv[1], "limits") == 0)
+        return run_limits(argc, argv);
+
+    const char *fu_file = NULL;
+    mem_params mem;
+    mem_params_default(&mem);
+    branch_params br;
+    branch_params_default(&br);
+    bool stats = false;
+    string options;
+    int nargs = 1;
+    bool bad_option = false;
+    for (int i = 1; i < argc; i++) {
+        int r = mem_parse_option(argv[i], &mem);
+        if (r == 0) r = branch_parse_option(argv[i], &br);
+        if (r < 0) bad_option = true;
+        if (strncmp(argv[i], "--fu=", 5) == 0) fu_file = argv[i] + 5;
+        else if (strcmp(argv[i], "--stats") == 0) stats = true;
+        else if (r == 0) {
+            argv[nargs++] = argv[i];
+            continue;
+        }
+        options += " ";
+        options += argv[i];
+    }
+    argc = nargs;
+
+    if (argc != 5 || bad_option) {
+        cerr << "Usage: " << argv[0] << " <ROB_SIZE> <IQ_SIZE> <WIDTH> <tracefile> [options]\n";
+        cerr << "       " << argv[0] << " sweep <ROB list> <IQ list> <WIDTH list> <tracefile> [--threads=N] [options]\n";
+        cerr << "       " << argv[0] << " simpoint <ROB_SIZE> <IQ_SIZE> <WIDTH> <tracefile> [--interval=N] [--k=N] [--warmup=N] [--seed=N] [--full] [options]\n";
+        cerr << "       " << argv[0] << " chunked <ROB_SIZE> <IQ_SIZE> <WIDTH> <tracefile> [--chunks=K] [--threads=N] [--overlap=N] [--timing] [--validate] [options]\n";
+        cerr << "       " << argv[0] << " limits <tracefile> [--rob=list] [--width=list] [--threads=N]\n";
+        cerr << "options: --fu=FILE  --stats\n";
+        cerr << "         --mem=<BLOCKSIZE>,<L1_SIZE>,<L1_ASSOC>,<L2_SIZE>,<L2_ASSOC>\n";
+        cerr << "         --mem-lat=<L1>,<L2>,<memory>  --mshr=N  --lsq=N\n";
+        cerr << "         --bp=bimodal,<M2> | gshare,<M1>,<N> | hybrid,<K>,<M1>,<N>,<M2>  --bp-penalty=N\n";
         return 1;
     }
 
-    ROB_SIZE = (int)strtoul(argv[1], NULL, 10);
-    IQ_SIZE = (int)strtoul(argv[2], NULL, 10);
-    WIDTH = (int)strtoul(argv[3], NULL, 10);
-
-    ROB.resize(ROB_SIZE);
-    for (int i = 0; i < ROB_SIZE; i++) {
-        ROB[i].valid = false;
-        ROB[i].ready = false;
-        ROB[i].dest_reg = -1;
-        ROB[i].inst = NULL;
+    static fu_config fu;
+    if (fu_file) {
+        const char *error;
+        int line;
+        if (!fu_config_load(fu_file, &fu, &error, &line)) {
+            cerr << "Error: " << fu_file << ":" << line << ": " << error << endl;
+            return 1;
+        }
     }
 
-    for (int i = 0; i < 67; i++) rename_table[i] = -1;
+    proc_params params;
+    params.rob_size = strtoul(argv[1], NULL, 10);
+    params.iq_size = strtoul(argv[2], NULL, 10);
+    params.width = strtoul(argv[3], NULL, 10);
+    params.fu = fu_file ? &fu : NULL;
+    params.mem = mem.enabled ? &mem : NULL;
+    params.br = br.enabled ? &br : NULL;
+    params.stats = stats;
+    int ROB_SIZE = (int)params.rob_size;
+    int IQ_SIZE = (int)params.iq_size;
+    int WIDTH = (int)params.width;
+    if (!mem_lsq_fits(&mem, params.width)) {
+        cerr << "Error: --lsq must be at least WIDTH" << endl;
+        return 1;
+    }
 
-    trace.open(argv[4]);
-    if (!trace.is_open()) {
+    FileTraceSource source;
+    if (!source.open(argv[4])) {
         cerr << "Error: Unable to open file " << argv[4] << endl;
         return 1;
     }
 
-    
-    
-    
-    do {
-        Retire();      
-        Writeback();   
-        Execute();     
-        Issue();       
-        Dispatch();    
-        RegRead();     
-        Rename();      
-        Decode();      
-        Fetch();       
-    } while (Advance_Cycle());
-
-    
-    for (instruction* inst : completed) {
-        cout << inst->seq_num << " fu{" << inst->op_type << "} "
-             << "src{" << inst->src1 << "," << inst->src2 << "} "
-             << "dst{" << inst->dest << "} ";
-
-        auto print_stage = [](const char* name, int begin, int dur) {
-            cout << name << "{";
-            if (begin != -1 && dur != -1) cout << begin << "," << dur;
-            else cout << "0,0";
-            cout << "} ";
-        };
-
-        print_stage("FE", inst->fe_begin, inst->fe_duration);
-        print_stage("DE", inst->de_begin, inst->de_duration);
-        print_stage("RN", inst->rn_begin, inst->rn_duration);
-        print_stage("RR", inst->rr_begin, inst->rr_duration);
-        print_stage("DI", inst->di_begin, inst->di_duration);
-        print_stage("IS", inst->is_begin, inst->is_duration);
-        print_stage("EX", inst->ex_begin, inst->ex_duration);
-        print_stage("WB", inst->wb_begin, inst->wb_duration);
-
-        cout << "RT{";
-        if (inst->rt_begin != -1 && inst->rt_duration != -1)
-            cout << inst->rt_begin << "," << inst->rt_duration;
-        else cout << "0,0";
-        cout << "}\n";
+    Processor proc(params, &source, true);
+    proc.run();
+    if (source.error) {
+        cerr << "Error: " << source.error << " in " << argv[4] << endl;
+        return 1;
     }
-    
+    int current_cycle = proc.current_cycle;
+    unsigned long int retired_count = proc.retired_count;
+
     cout << "# === Simulator Command =========\n";
-    cout << "# ./sim " << ROB_SIZE << " " << IQ_SIZE << " " << WIDTH << " " << argv[4] << endl;
+    cout << "# ./sim " << ROB_SIZE << " " << IQ_SIZE << " " << WIDTH << " " << argv[4] << options << endl;
     cout << "# === Processor Configuration ===\n";
     cout << "# ROB_SIZE = " << ROB_SIZE << "\n# IQ_SIZE  = " << IQ_SIZE << "\n# WIDTH    = " << WIDTH << endl;
     cout << "# === Simulation Results ========\n";
-    cout << "# Dynamic Instruction Count    = " << completed.size() << endl;
+    cout << "# Dynamic Instruction Count    = " << retired_count << endl;
     cout << "# Cycles                       = " << current_cycle << endl;
     cout << fixed << setprecision(2);
     if (current_cycle > 0)
-        cout << "# Instructions Per Cycle (IPC) = " << (double)completed.size() / current_cycle << endl;
+        cout << "# Instructions Per Cycle (IPC) = " << (double)retired_count / current_cycle << endl;
     else
         cout << "# Instructions Per Cycle (IPC) = 0.00" << endl;
+    if (proc.stats) print_stats(*proc.stats, current_cycle, retired_count);
+
+    if (fu_file) {
+        cout << "# === Functional Units ==========\n";
+        cout << "# " << left << setw(12) << "class" << right << setw(6) << "units" << setw(12) << "issued"
+             << setw(12) << "util(%)" << setw(16) << "port conflicts" << setw(12) << "unit busy" << endl;
+        for (size_t c = 0; c < fu.classes.size(); c++) {
+            const fu_class &cls = fu.classes[c];
+            const fu_stat &st = proc.fu_stats[c];
+            double capacity = (double)cls.num_units * current_cycle;
+            cout << "# " << left << setw(12) << cls.name << right << setw(6) << cls.num_units << setw(12) << st.issued
+                 << setw(12) << (capacity > 0 ? st.busy_cycles / capacity * 100 : 0.0)
+                 << setw(16) << st.port_conflicts << setw(12) << st.unit_busy << endl;
+        }
+    }
+
+    if (br.enabled) {
+        cout << "# === Branch Prediction =========\n";
+        cout << "# branches                     = " << proc.branches << endl;
+        cout << "# mispredictions               = " << proc.mispredictions << endl;
+        cout << "# misprediction rate           = "
+             << (proc.branches ? (double)proc.mispredictions / proc.branches * 100 : 0.0) << "%" << endl;
+        cout << "# MPKI                         = "
+             << (retired_count ? (double)proc.mispredictions * 1000 / retired_count : 0.0) << endl;
+        cout << "# fetch cycles lost            = " << proc.mispredict_cycles << endl;
+    }
 
-    trace.close();
-    for (instruction* inst : completed) delete inst;
+    if (proc.memory) {
+        const MemorySystem &m = *proc.memory;
+        cout << setprecision(4);
+        cout << "# === Memory System =============\n";
+        cout << "# L1 reads                     = " << m.l1.reads << endl;
+        cout << "# L1 read misses               = " << m.l1.read_misses << endl;
+        cout << "# L1 writes                    = " << m.l1.writes << endl;
+        cout << "# L1 write misses              = " << m.l1.write_misses << endl;
+        cout << "# L1 miss rate                 = "
+             << (m.l1.reads + m.l1.writes ? (double)(m.l1.read_misses + m.l1.write_misses) / (m.l1.reads + m.l1.writes) : 0.0) << endl;
+        cout << "# L1 writebacks                = " << m.l1.writebacks << endl;
+        if (m.l2.present()) {
+            cout << "# L2 reads                     = " << m.l2.reads << endl;
+            cout << "# L2 read misses               = " << m.l2.read_misses << endl;
+            cout << "# L2 writes                    = " << m.l2.writes << endl;
+            cout << "# L2 write misses              = " << m.l2.write_misses << endl;
+            cout << "# L2 miss rate                 = " << (m.l2.reads ? (double)m.l2.read_misses / m.l2.reads : 0.0) << endl;
+            cout << "# L2 writebacks                = " << m.l2.writebacks << endl;
+        }
+        cout << "# memory traffic               = " << m.mem_reads + m.mem_writes << endl;
+        cout << "# loads forwarded from stores  = " << m.forwarded << endl;
+        cout << "# loads merged into a miss     = " << m.mshr_merges << endl;
+        cout << "# loads stalled, MSHRs full    = " << m.mshr_stalls << endl;
+        cout << "# cycles stalled, LSQ full     = " << proc.lsq_full_cycles << endl;
+    }
 
     return 0;
 }
@@ -1,12 +1,287 @@
 #ifndef SIM_PROC_H
 #define SIM_PROC_H
 
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include <unordered_map>
+#include "proc_trace.h"
+#include "proc_fu.h"
+#include "proc_mem.h"
+#include "proc_branch.h"
+
 typedef struct proc_params{
     unsigned long int rob_size;
     unsigned long int iq_size;
     unsigned long int width;
+    const fu_config *fu;    // NULL: WIDTH universal pipelined units
+    const mem_params *mem;  // NULL: loads and stores are ordinary ops
+    const branch_params *br;    // NULL: perfect branch prediction
+    bool stats;             // collect proc_stats (--stats)
 }proc_params;
 
 // Put additional data structures here as per your requirement
 
+static inline int get_latency(int op) {
+    switch(op) {
+        case 0: return 1;
+        case 1: return 2;
+        case 2: return 5;
+        default: return 1;  
+    }
+}
+
+// Pipeline stages, in the order of an instruction's timing line.
+enum pipe_stage { ST_FE, ST_DE, ST_RN, ST_RR, ST_DI, ST_IS, ST_EX, ST_WB, ST_RT, NUM_STAGES };
+
+// An instruction's identity and stage timing.  Written only as it moves
+// between stages and read only to report it once it retires, so it is kept
+// apart from the fields the scheduling loops touch every cycle.
+struct inst_timing {
+    int seq_num;
+    int op_type;
+    int dest, src1, src2;
+    int begin[NUM_STAGES], duration[NUM_STAGES];    // -1 until reached
+};
+
+// Formats an instruction's retirement timing line, "<seq> fu{..} src{..}
+// dst{..} FE{begin,duration} ... RT{..}\n", at p; returns the end.  A line
+// is at most 9 stages of 2 ints plus 6 ints and labels.
+#define TIMING_LINE_MAX 320
+char *put_timing_line(char *p, const inst_timing *t);
+
+// A retired instruction's stage timing, for callers that format it later.
+// Each stage begins where the one before it ended, so FE's begin and the
+// nine durations (FE..RT) give every stage.
+struct retired_timing {
+    int fe_begin;
+    int duration[NUM_STAGES];
+};
+
+// Fetched but not yet renamed, so without a ROB slot.
+struct fetched_inst {
+    trace_record rec;
+    inst_timing timing;
+};
+
+// A renamed instruction, by ROB slot, waiting on a tag; seq_num guards
+// against the slot having been retired and reused by the time the tag
+// completes.
+struct wakeup_ref {
+    int slot;
+    int seq_num;
+};
+
+// Per unit class counts, with a unit configuration.  An instruction that is
+// ready but cannot issue counts once per cycle it waits: as a port conflict
+// if a unit of its class was idle but that unit's port had already issued,
+// otherwise as a unit busy stall.
+struct fu_stat {
+    unsigned long int issued;
+    unsigned long int busy_cycles;      // unit-cycles occupied
+    unsigned long int port_conflicts;
+    unsigned long int unit_busy;
+};
+
+// Why a stage with work to do did nothing in a cycle.  Each is one of the
+// stage early-outs: a stage whose input bundle is empty is idle, not
+// stalled, and Issue stalls only when it issued nothing from a non-empty IQ.
+enum stall_reason {
+    STALL_TRACE_DONE,       // Fetch: trace exhausted
+    STALL_REDIRECT,         // Fetch: waiting out a mispredicted branch
+    STALL_DE_BUSY,          // Fetch: DE still holds a bundle
+    STALL_RN_BUSY,          // Decode: RN still holds a bundle
+    STALL_RR_BUSY,          // Rename: RR still holds a bundle
+    STALL_ROB_FULL,         // Rename
+    STALL_DI_BUSY,          // RegRead: DI still holds a bundle
+    STALL_IQ_FULL,          // Dispatch
+    STALL_LSQ_FULL,         // Dispatch
+    STALL_NOT_READY,        // Issue: no IQ entry has its operands
+    STALL_STRUCTURAL,       // Issue: ready entries found no unit, port or MSHR
+    NUM_STALLS
+};
+
+// CPI stack: each cycle Retire commits something counts as base; any other
+// cycle is charged to whatever holds up the oldest instruction, or to the
+// front end (or a branch redirect) if the ROB head has not reached the IQ.
+enum cpi_category {
+    CPI_BASE,
+    CPI_FRONTEND,
+    CPI_BRANCH,
+    CPI_DEPENDENCY,         // head in the IQ waiting on operands
+    CPI_STRUCTURAL,         // head ready in the IQ but not issued
+    CPI_EXECUTE,            // head executing or writing back
+    CPI_MEMORY,             // head is a load that missed L1
+    NUM_CPI
+};
+
+struct proc_stats {
+    unsigned long int stalls[NUM_STALLS];
+    unsigned long int cpi[NUM_CPI];             // cycles
+    std::vector<unsigned long int> rob_hist;    // cycles at each occupancy,
+    std::vector<unsigned long int> iq_hist;     // sampled at cycle end
+};
+
+// One out-of-order pipeline.  All state lives in the object, so several
+// configurations can be simulated side by side.
+class Processor {
+public:
+    // With print_timing set, every retired instruction's timing line is
+    // written to stdout as it retires.
+    Processor(const proc_params &params, TraceSource *source, bool print_timing);
+    ~Processor();
+
+    // Simulates until the trace is exhausted and the pipeline has drained.
+    void run();
+
+    // Simulates until at least retired instructions have retired or the
+    // pipeline has drained; a later run_until() or run() carries on from
+    // there.
+    void run_until(unsigned long int retired);
+
+    // Trains the branch predictor and caches on an instruction that is not
+    // simulated, as if it had gone by just before the next one fetched.
+    void warm(const trace_record &rec);
+
+    int current_cycle;
+    unsigned long int retired_count;
+    std::vector<fu_stat> fu_stats;
+
+    // With a memory model: the caches and their counts, and the cycles a
+    // dispatch group waited for LSQ space.
+    MemorySystem *memory;
+    unsigned long int lsq_full_cycles;
+
+    // With a branch predictor: conditional branches seen, how many were
+    // mispredicted, and the cycles Fetch sat waiting on them.
+    unsigned long int branches, mispredictions, mispredict_cycles;
+
+    // With params.stats, NULL otherwise.
+    proc_stats *stats;
+
+    // When set, every retiring instruction's timing is appended here.
+    std::vector<retired_timing> *timing_log;
+
+private:
+    int ROB_SIZE, IQ_SIZE, WIDTH;
+    TraceSource *source;
+    bool print_timing;
+
+    int instruction_counter;
+    bool trace_done;
+    bool source_done;
+    bool drained;
+
+    // After a mispredicted branch Fetch waits until fetch_resume_cycle,
+    // which stays INT_MAX until the branch (mispredict_seq) has executed.
+    BranchPredictor *predictor;
+    int bp_penalty;
+    int fetch_resume_cycle;
+    int mispredict_seq, mispredict_fetch_cycle;
+
+    // The instruction window is indexed by ROB slot, one array per field.
+    // Scheduling state sits in dense arrays of its own; timing holds the
+    // cold per-instruction record.  seq is -1 in a free slot, and a slot's
+    // ready bit stays set after it retires, as readers of a stale source
+    // tag expect.
+    int rob_head, rob_tail, rob_count;
+    std::vector<int> seq, op, dest;
+    std::vector<uint8_t> ready;                 // result written back
+    std::vector<int> src1_tag, src2_tag;
+    std::vector<uint8_t> src1_ready, src2_ready;
+    std::vector<int> mem_tag;                   // older in-flight store to the same word, for a load
+    std::vector<uint8_t> mem_ready;
+    std::vector<uint64_t> mem_addr;
+    std::vector<uint8_t> in_iq;
+    std::vector<int> done_cycle;                // cycle whose Execute completes it; -1 until issued
+    std::vector<int> fu_unit;                   // unit executing it, with a unit configuration
+    std::vector<uint8_t> mem_miss;              // a load that missed L1 or merged into a miss
+    // every renamed instruction that named the slot's tag as a source since
+    // the tag last completed, whether or not the slot has been reallocated
+    std::vector<std::vector<wakeup_ref> > consumers;
+    std::vector<inst_timing> timing;
+
+    // Pipeline latches.  DE and RN hold fetched groups back to back in a
+    // ring of 2 * WIDTH entries, RN the older one.  Renamed groups are runs
+    // of consecutive ROB slots, so RR and DI are just a first slot and a
+    // count.  WB lists the slots completing this cycle.
+    std::vector<fetched_inst> front;
+    int front_head, rn_count, de_count;
+    int rr_first, rr_count, di_first, di_count;
+    std::vector<int> WB;
+
+    int rename_table[PROC_TRACE_REGS];
+
+    // The issue queue is kept as a bitmap over ROB slots: a bit is set while
+    // the instruction in that slot sits in the IQ with both operands ready.
+    // ROB order from rob_head is program order, so the first set bit from
+    // the head is the oldest ready instruction.
+    std::vector<uint64_t> iq_ready;
+    int iq_count;
+
+    // Executing instructions sit in a timing wheel bucketed by done_cycle.
+    // The wheel is longer than any latency, so a bucket only ever holds
+    // instructions finishing in the cycle it is visited.
+    std::vector<std::vector<int> > ex_wheel;
+    int ex_wheel_mask;
+    int ex_count;
+    std::vector<int> completed_execution;
+
+    // With a unit configuration, Issue takes ready instructions oldest first
+    // into a free unit whose port has not issued this cycle; unpipelined
+    // units hold their unit_busy bit until the instruction completes.  A
+    // unit's latency includes any memory access of the load it executes.
+    const fu_config *fu;
+    uint64_t unit_busy;
+    std::vector<uint64_t> issue_cand;
+
+    // Loads and stores hold an LSQ entry from Dispatch to Retire.  A load
+    // renamed after a store to the same 8-byte word waits for that store as
+    // if for a source register, then takes its data with an L1 hit's
+    // latency instead of accessing the cache.
+    int lsq_size, lsq_count;
+    bool lsq_blocked;
+    std::unordered_map<uint64_t, int> store_tags;   // word -> youngest store
+
+    std::vector<trace_record> fetch_buf;     // read ahead, not yet fetched
+    int fetch_len;
+
+    // Retired instructions are formatted straight into this buffer, which is
+    // written out whenever it fills and once more at the end of run().
+    std::vector<char> out_buf;
+    size_t out_len;
+
+    void flush_output();
+    void write_retired(const inst_timing *t);
+
+    void update_issue_ready(int slot);
+    void update_consumers_ready(int tag);
+    int find_oldest_ready(const std::vector<uint64_t> &candidates);
+    void issue_instruction(int slot, int latency);
+    void Issue_constrained();
+    bool can_dispatch();
+    bool pipeline_quiescent();
+
+    int fetch_stall();
+    int decode_stall();
+    int rename_stall();
+    int regread_stall();
+    int dispatch_stall();
+    int issue_stall();
+    int cpi_category();
+    void count_stall(int reason, unsigned long int cycles);
+    void count_skipped(unsigned long int cycles);
+
+    void Fetch();
+    void Decode();
+    void Rename();
+    void RegRead();
+    void Dispatch();
+    void Issue();
+    void Execute();
+    void Writeback();
+    void Retire();
+    bool Advance_Cycle();
+};
+
 #endif
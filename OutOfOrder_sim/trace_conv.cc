@@ -0,0 +1,64 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include "proc_trace.h"
+
+// trace_conv <in> <out>      convert an instruction trace to binary
+// trace_conv -t <in> <out>   convert an instruction trace to text
+
+int main(int argc, char* argv[]) {
+    bool to_text = false;
+    if (argc == 4 && strcmp(argv[1], "-t") == 0) {
+        to_text = true;
+        argv++;
+        argc--;
+    }
+    if (argc != 3) {
+        fprintf(stderr, "Usage: %s [-t] <input trace> <output trace>\n", argv[0]);
+        return 1;
+    }
+
+    FileTraceSource source;
+    if (!source.open(argv[1])) {
+        fprintf(stderr, "Error: Unable to open file %s\n", argv[1]);
+        return 1;
+    }
+
+    static TraceWriter writer;
+    FILE *text = NULL;
+    bool ok = to_text ? (text = fopen(argv[2], "w")) != NULL : writer.create(argv[2]);
+    if (!ok) {
+        fprintf(stderr, "Error: Unable to open file %s\n", argv[2]);
+        return 1;
+    }
+
+    trace_record recs[256];
+    unsigned long int count = 0;
+    int n;
+    while ((n = source.read(recs, 256)) > 0) {
+        for (int i = 0; i < n; i++) {
+            if (to_text) {
+                fprintf(text, "%" PRIx64 " %d %d %d %d", recs[i].pc, recs[i].op_type, recs[i].dest, recs[i].src1, recs[i].src2);
+                if (trace_is_mem_op(recs[i].op_type)) fprintf(text, " %" PRIx64, recs[i].mem_addr);
+                if (trace_is_branch(recs[i].op_type)) fprintf(text, " %c", recs[i].taken ? 't' : 'n');
+                fputc('\n', text);
+            } else if (!writer.add(recs[i])) {
+                fprintf(stderr, "Error: record %lu of %s does not fit the binary format\n", count, argv[1]);
+                return 1;
+            }
+            count++;
+        }
+    }
+    if (source.error) {
+        fprintf(stderr, "Error: %s in %s\n", source.error, argv[1]);
+        return 1;
+    }
+    ok = to_text ? fclose(text) == 0 : writer.finish();
+    if (!ok) {
+        fprintf(stderr, "Error: Unable to write file %s\n", argv[2]);
+        return 1;
+    }
+    printf("%lu instructions written to %s\n", count, argv[2]);
+    return 0;
+}
@@ -0,0 +1,39 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "proc_gen.h"
+
+// trace_gen [-t] <pattern> <instructions> <seed> <out>
+//
+// Writes a synthetic instruction trace (binary, or text with -t); see
+// proc_gen.h for the patterns.
+
+int main(int argc, char* argv[]) {
+    bool text = false;
+    if (argc == 6 && strcmp(argv[1], "-t") == 0) {
+        text = true;
+        argv++;
+        argc--;
+    }
+    if (argc != 5) {
+        fprintf(stderr, "Usage: %s [-t] <pattern> <instructions> <seed> <output trace>\n", argv[0]);
+        fprintf(stderr, "patterns:");
+        for (int p = 0; p < PROC_GEN_PATTERNS; p++) fprintf(stderr, " %s", proc_gen_names[p]);
+        fprintf(stderr, "\n");
+        return 1;
+    }
+
+    int pattern = proc_gen_pattern(argv[1]);
+    unsigned long int count = strtoul(argv[2], NULL, 10);
+    uint64_t seed = strtoull(argv[3], NULL, 10);
+    if (pattern < 0) {
+        fprintf(stderr, "Error: Unknown pattern %s\n", argv[1]);
+        return 1;
+    }
+    if (!proc_gen_write(argv[4], pattern, count, seed, !text)) {
+        fprintf(stderr, "Error: Unable to write file %s\n", argv[4]);
+        return 1;
+    }
+    printf("%lu instructions written to %s\n", count, argv[4]);
+    return 0;
+}
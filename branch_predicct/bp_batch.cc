@@ -0,0 +1,79 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bp_batch.h"
+
+int bp_batch_init(bp_batch *batch, const bp_params *configs, unsigned int count)
+{
+    memset(batch, 0, sizeof(*batch));
+
+    // entry 0 is a scratch counter that the padding lanes of the last group hit
+    unsigned long int total = 1;
+    for(unsigned int i = 0; i < count; i++) {
+        total += bp_batch_entries(&configs[i]);
+        if(total > BP_BATCH_MAX_ENTRIES) {
+            batch->error = "tables need more than 2^31 counters in total";
+            return -1;
+        }
+    }
+
+    batch->count = count;
+    batch->num_groups = (count + BP_LANES - 1) / BP_LANES;
+    batch->configs = (bp_params*)malloc(count * sizeof(bp_params));
+    batch->groups = (bp_batch_group*)aligned_alloc(sizeof(bp_vec), batch->num_groups * sizeof(bp_batch_group));
+    batch->mispredictions = (unsigned long int*)calloc(count, sizeof(unsigned long int));
+    batch->tables = (uint8_t*)malloc(total);
+    if(!batch->configs || !batch->groups || !batch->mispredictions || !batch->tables) {
+        bp_batch_free(batch);
+        batch->error = "unable to allocate the tables";
+        return -1;
+    }
+    memcpy(batch->configs, configs, count * sizeof(bp_params));
+    batch->table_entries = total;
+    memset(batch->tables, 2, total);
+
+    unsigned long int base = 1;
+    for(unsigned int g = 0; g < batch->num_groups; g++) {
+        bp_batch_group *grp = &batch->groups[g];
+        memset(grp, 0, sizeof(*grp));
+        for(int l = 0; l < BP_LANES; l++) {
+            unsigned int i = g * BP_LANES + l;
+            if(i >= count) continue;
+            unsigned long int m, n;
+            if(strcmp(configs[i].bp_name, "bimodal") == 0) {
+                m = configs[i].M2;
+                n = 0;
+            } else {
+                m = configs[i].M1;
+                n = configs[i].N;
+            }
+            grp->mask[l]  = (int32_t)((1UL << m) - 1);
+            grp->shift[l] = (int32_t)(m - n);
+            grp->hbit[l]  = (n > 0) ? (int32_t)(1UL << (n - 1)) : 0;
+            grp->base[l]  = (int32_t)base;
+            base += 1UL << m;
+        }
+    }
+    return 0;
+}
+
+void bp_batch_finish(bp_batch *batch)
+{
+    for(unsigned int g = 0; g < batch->num_groups; g++) {
+        bp_batch_group *grp = &batch->groups[g];
+        for(int l = 0; l < BP_LANES; l++) {
+            unsigned int i = g * BP_LANES + l;
+            if(i < batch->count) batch->mispredictions[i] += (uint32_t)grp->miss[l];
+            grp->miss[l] = 0;
+        }
+    }
+    batch->since_fold = 0;
+}
+
+void bp_batch_free(bp_batch *batch)
+{
+    free(batch->configs);
+    free(batch->groups);
+    free(batch->mispredictions);
+    free(batch->tables);
+}
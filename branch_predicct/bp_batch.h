@@ -0,0 +1,86 @@
+#ifndef BP_BATCH_H
+#define BP_BATCH_H
+
+#include <stdint.h>
+#include <string.h>
+#include "sim_bp.h"
+
+// Lockstep engine: a group of gshare/bimodal configurations that share one
+// trace.  Each group of BP_LANES configurations computes its table indices
+// with one vector operation per branch; bimodal and gshare with N = 0 are
+// lanes whose history register never leaves zero.
+
+#define BP_LANES 8
+
+// Table indices are int32 lanes, so all the tables of a batch together
+// (plus one scratch counter) must stay below 2^31 entries.
+#define BP_BATCH_MAX_ENTRIES (1UL << 31)
+
+typedef int32_t bp_vec __attribute__((vector_size(BP_LANES * sizeof(int32_t))));
+
+typedef struct bp_batch_group{
+    bp_vec   mask;          // (1 << M) - 1
+    bp_vec   shift;         // M - N, where the history is xor'ed in
+    bp_vec   hbit;          // 1 << (N - 1), or 0 without history
+    bp_vec   ghr;
+    bp_vec   base;          // offset of the lane's table in bp_batch::tables
+    bp_vec   miss;          // mispredictions since the last fold
+}bp_batch_group;
+
+typedef struct bp_batch{
+    unsigned int           count;
+    unsigned int           num_groups;
+    bp_params             *configs;
+    bp_batch_group        *groups;
+    uint8_t               *tables;
+    unsigned long int      table_entries;
+    unsigned long int      predictions;
+    unsigned long int     *mispredictions;
+    unsigned long int      since_fold;
+    const char            *error;
+}bp_batch;
+
+// Counters in the table of one configuration.
+static inline unsigned long int bp_batch_entries(const bp_params *config)
+{
+    return 1UL << (strcmp(config->bp_name, "bimodal") == 0 ? config->M2 : config->M1);
+}
+
+// configs[i].bp_name must be "bimodal" (M2) or "gshare" (M1, N).  Returns
+// 0, or -1 with batch->error set if the tables are too large for one batch
+// or cannot be allocated; nothing needs freeing then.
+int bp_batch_init(bp_batch *batch, const bp_params *configs, unsigned int count);
+void bp_batch_free(bp_batch *batch);
+
+// Folds the per-lane vector counters into batch->mispredictions; call before
+// reading results.
+void bp_batch_finish(bp_batch *batch);
+
+static inline void bp_batch_step(bp_batch *batch, unsigned long int addr, int taken)
+{
+    const bp_vec pc = (bp_vec){} + (int32_t)(uint32_t)(addr >> 2);
+    const bp_vec tv = (bp_vec){} - (int32_t)(taken ? 1 : 0);
+    uint8_t *tables = batch->tables;
+
+    for(unsigned int g = 0; g < batch->num_groups; g++) {
+        bp_batch_group *grp = &batch->groups[g];
+        bp_vec idx = grp->base + ((pc & grp->mask) ^ (grp->ghr << grp->shift));
+
+        bp_vec ctr;
+        for(int l = 0; l < BP_LANES; l++) ctr[l] = tables[(uint32_t)idx[l]];
+
+        // comparisons yield -1 for true lanes
+        grp->miss -= (ctr > 1) ^ tv;
+        if(taken) ctr -= (ctr < 3);
+        else      ctr += (ctr > 0);
+
+        for(int l = 0; l < BP_LANES; l++) tables[(uint32_t)idx[l]] = (uint8_t)ctr[l];
+
+        grp->ghr = (grp->ghr >> 1) | (tv & grp->hbit);
+    }
+
+    batch->predictions++;
+    if(++batch->since_fold == (1UL << 30)) bp_batch_finish(batch);
+}
+
+#endif
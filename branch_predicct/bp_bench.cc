@@ -0,0 +1,261 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "bp_gen.h"
+
+// bp_bench [--update] [--runs=N] [--branches=N] [--static=N] [--tolerance=PCT]
+//          [--sim=PATH] <baseline file>
+//
+// Runs sim over a synthetic trace of every bp_gen pattern with each benchmark
+// predictor and reports simulated branches per second (best of --runs,
+// default 5), peak RSS and misprediction rate.  The results are compared
+// against the baseline file: a case fails if its throughput dropped by more
+// than --tolerance percent (default 15) even after re-measuring, or if it
+// mispredicts more branches than the baseline did.  Without a baseline file,
+// or with --update, the results become the new baseline.  Results are also
+// written to bench_results.txt.
+//
+// Traces are generated into bench_traces/ once and reused.
+
+#define BENCH_DIR     "bench_traces"
+#define BENCH_RESULTS "bench_results.txt"
+#define MAX_CASES     64
+
+static const char *predictors[][8] = {
+    { "bimodal", "14", NULL },
+    { "gshare", "16", "6", NULL },
+    { "hybrid", "12", "16", "6", "14", NULL },
+    { "hybrid", "12", "16", "6", "14", "--loop", "--sc", NULL },
+};
+#define NUM_PREDICTORS (int)(sizeof(predictors) / sizeof(predictors[0]))
+
+typedef struct bench_case{
+    char               name[64];
+    double             branches_per_sec;
+    long int           rss_kb;
+    unsigned long int  predictions;
+    unsigned long int  mispredictions;
+    int                predictor;   // not saved: what to re-run
+    char               trace[128];
+}bench_case;
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static unsigned long int output_value(const char *out, const char *label)
+{
+    const char *p = strstr(out, label);
+    return p ? strtoul(p + strlen(label), NULL, 10) : 0;
+}
+
+// Runs sim once; returns 0 on success and fills seconds, rss and the counts.
+static int run_sim(const char *sim, const char **args, const char *trace, double *seconds, long int *rss_kb,
+                   unsigned long int *predictions, unsigned long int *mispredictions)
+{
+    const char *argv[16];
+    int n = 0;
+    argv[n++] = sim;
+    for(int i = 0; args[i] && args[i][0] != '-'; i++) argv[n++] = args[i];
+    argv[n++] = trace;
+    for(int i = 0; args[i]; i++) if(args[i][0] == '-') argv[n++] = args[i];
+    argv[n++] = "--no-dump";
+    argv[n] = NULL;
+
+    int fd[2];
+    if(pipe(fd) != 0) return -1;
+    double start = now();
+    pid_t pid = fork();
+    if(pid < 0) return -1;
+    if(pid == 0) {
+        dup2(fd[1], STDOUT_FILENO);
+        close(fd[0]);
+        close(fd[1]);
+        execv(sim, (char* const*)argv);
+        _exit(127);
+    }
+    close(fd[1]);
+
+    static char out[1 << 16];
+    size_t len = 0;
+    ssize_t r;
+    while((r = read(fd[0], out + len, sizeof(out) - 1 - len)) > 0) len += (size_t)r;
+    out[len] = '\0';
+    close(fd[0]);
+
+    int status;
+    struct rusage ru;
+    if(wait4(pid, &status, 0, &ru) != pid) return -1;
+    *seconds = now() - start;
+    if(!WIFEXITED(status) || WEXITSTATUS(status) != 0) return -1;
+
+    *rss_kb = ru.ru_maxrss;
+    *predictions = output_value(out, "number of predictions:");
+    *mispredictions = output_value(out, "number of mispredictions:");
+    return *predictions ? 0 : -1;
+}
+
+// Best-of-runs throughput; a repeated measurement keeps the better result.
+static void measure(const char *sim, int runs, bench_case *c)
+{
+    for(int run = 0; run < runs; run++) {
+        double seconds;
+        long int rss_kb;
+        if(run_sim(sim, predictors[c->predictor], c->trace, &seconds, &rss_kb, &c->predictions, &c->mispredictions) != 0)
+        {
+            printf("Error: %s failed on %s\n", sim, c->trace);
+            exit(EXIT_FAILURE);
+        }
+        double bps = (double)c->predictions / seconds;
+        if(bps > c->branches_per_sec) c->branches_per_sec = bps;
+        if(rss_kb > c->rss_kb) c->rss_kb = rss_kb;
+    }
+}
+
+static int read_baseline(const char *path, bench_case *cases)
+{
+    FILE *in = fopen(path, "r");
+    if(in == NULL) return -1;
+    char line[256];
+    int n = 0;
+    while(n < MAX_CASES && fgets(line, sizeof(line), in)) {
+        if(line[0] == '#') continue;
+        bench_case *c = &cases[n];
+        if(sscanf(line, "%63s %lf %ld %lu %lu", c->name, &c->branches_per_sec, &c->rss_kb, &c->predictions, &c->mispredictions) == 5)
+            n++;
+    }
+    fclose(in);
+    return n;
+}
+
+static int write_cases(const char *path, const bench_case *cases, int n)
+{
+    FILE *out = fopen(path, "w");
+    if(out == NULL) return -1;
+    fprintf(out, "# case branches/s peak_rss_kb predictions mispredictions\n");
+    for(int i = 0; i < n; i++)
+        fprintf(out, "%s %.0f %ld %lu %lu\n", cases[i].name, cases[i].branches_per_sec, cases[i].rss_kb,
+                cases[i].predictions, cases[i].mispredictions);
+    return fclose(out);
+}
+
+int main (int argc, char* argv[])
+{
+    int update = 0, runs = 5;
+    unsigned long int num_branches = 2000000, num_static = 1024;
+    double tolerance = 15.0;
+    const char *sim = "./sim";
+    const char *baseline_file = NULL;
+
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "--update") == 0) update = 1;
+        else if(strncmp(argv[i], "--runs=", 7) == 0) runs = atoi(argv[i] + 7);
+        else if(strncmp(argv[i], "--branches=", 11) == 0) num_branches = strtoul(argv[i] + 11, NULL, 10);
+        else if(strncmp(argv[i], "--static=", 9) == 0) num_static = strtoul(argv[i] + 9, NULL, 10);
+        else if(strncmp(argv[i], "--tolerance=", 12) == 0) tolerance = atof(argv[i] + 12);
+        else if(strncmp(argv[i], "--sim=", 6) == 0) sim = argv[i] + 6;
+        else if(argv[i][0] != '-' && baseline_file == NULL) baseline_file = argv[i];
+        else {
+            printf("Usage: %s [--update] [--runs=N] [--branches=N] [--static=N] [--tolerance=PCT] [--sim=PATH] <baseline file>\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if(baseline_file == NULL || runs < 1 || num_branches == 0 || num_static == 0)
+    {
+        printf("Error: need a baseline file, and positive --runs, --branches and --static\n");
+        exit(EXIT_FAILURE);
+    }
+
+    mkdir(BENCH_DIR, 0755);
+
+    static bench_case results[MAX_CASES], baseline[MAX_CASES];
+    int num_results = 0;
+    int num_baseline = update ? -1 : read_baseline(baseline_file, baseline);
+
+    printf("%-36s %12s %10s %14s %10s\n", "case", "branches/s", "peak RSS", "mispredictions", "rate");
+    for(int p = 0; p < BP_GEN_PATTERNS; p++) {
+        char trace[128];
+        snprintf(trace, sizeof(trace), BENCH_DIR "/%s-%lu-%lu.bpt", bp_gen_names[p], num_branches, num_static);
+        if(access(trace, R_OK) != 0 && bp_gen_write(trace, p, num_branches, num_static, 1, 1) != 0)
+        {
+            printf("Error: Unable to write file %s\n", trace);
+            exit(EXIT_FAILURE);
+        }
+
+        for(int k = 0; k < NUM_PREDICTORS; k++) {
+            bench_case *c = &results[num_results++];
+            int len = snprintf(c->name, sizeof(c->name), "%s/", bp_gen_names[p]);
+            for(int i = 0; predictors[k][i]; i++) {
+                const char *a = predictors[k][i];
+                if(a[0] == '-') len += snprintf(c->name + len, sizeof(c->name) - len, "+%s", a + 2);
+                else len += snprintf(c->name + len, sizeof(c->name) - len, i ? "-%s" : "%s", a);
+            }
+
+            c->predictor = k;
+            snprintf(c->trace, sizeof(c->trace), "%s", trace);
+            c->branches_per_sec = 0;
+            c->rss_kb = 0;
+            measure(sim, runs, c);
+            printf("%-36s %11.2fM %7.1f MB %14lu %9.2f%%\n", c->name, c->branches_per_sec / 1e6, c->rss_kb / 1024.0,
+                   c->mispredictions, (double)c->mispredictions / c->predictions * 100);
+        }
+    }
+
+    if(num_baseline < 0) {
+        write_cases(BENCH_RESULTS, results, num_results);
+        if(write_cases(baseline_file, results, num_results) != 0)
+        {
+            printf("Error: Unable to write file %s\n", baseline_file);
+            exit(EXIT_FAILURE);
+        }
+        printf("baseline written to %s\n", baseline_file);
+        return 0;
+    }
+
+    int failures = 0;
+    for(int i = 0; i < num_results; i++) {
+        bench_case *c = &results[i];
+        const bench_case *b = NULL;
+        for(int j = 0; j < num_baseline && !b; j++)
+            if(strcmp(baseline[j].name, c->name) == 0) b = &baseline[j];
+        if(b == NULL) continue;
+        if(b->predictions != c->predictions) {
+            printf("FAIL %s: %lu predictions, baseline has %lu (different trace?)\n", c->name, c->predictions, b->predictions);
+            failures++;
+            continue;
+        }
+        if(c->mispredictions > b->mispredictions) {
+            printf("FAIL %s: accuracy regression, %lu mispredictions vs %lu\n", c->name, c->mispredictions, b->mispredictions);
+            failures++;
+        }
+        // a slow case is measured twice more before it counts, to ride out
+        // interference from whatever else the machine is doing
+        double floor = b->branches_per_sec * (1.0 - tolerance / 100);
+        for(int retry = 0; retry < 2 && c->branches_per_sec < floor; retry++)
+            measure(sim, runs, c);
+        if(c->branches_per_sec < floor) {
+            printf("FAIL %s: throughput regression, %.2fM vs %.2fM branches/s\n", c->name,
+                   c->branches_per_sec / 1e6, b->branches_per_sec / 1e6);
+            failures++;
+        }
+    }
+    if(write_cases(BENCH_RESULTS, results, num_results) != 0)
+    {
+        printf("Error: Unable to write file %s\n", BENCH_RESULTS);
+        exit(EXIT_FAILURE);
+    }
+    if(failures) {
+        printf("%d regression(s) against %s\n", failures, baseline_file);
+        return 1;
+    }
+    printf("no regressions against %s\n", baseline_file);
+    return 0;
+}
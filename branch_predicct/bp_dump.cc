@@ -0,0 +1,124 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bp_dump.h"
+
+static char *format_int(char *p, unsigned int v)
+{
+    char tmp[10];
+    int n = 0;
+    do {
+        tmp[n++] = (char)('0' + v % 10);
+        v /= 10;
+    } while(v);
+    while(n) *p++ = tmp[--n];
+    return p;
+}
+
+void bp_dump_text(FILE *out, const char *title, const uint8_t *table, unsigned long int size)
+{
+    static char buf[1 << 16];
+    char *p = buf;
+
+    fprintf(out, "FINAL %s CONTENTS\n", title);
+    for(unsigned long int i = 0; i < size; i++) {
+        // one line is at most 10 + 1 + 10 + 1 characters
+        if(p > buf + sizeof(buf) - 24) {
+            fwrite(buf, 1, p - buf, out);
+            p = buf;
+        }
+        p = format_int(p, (unsigned int)i);
+        *p++ = '\t';
+        p = format_int(p, table[i]);
+        *p++ = '\n';
+    }
+    fwrite(buf, 1, p - buf, out);
+}
+
+static int write_u32(FILE *out, uint32_t v)
+{
+    uint8_t b[4] = { (uint8_t)v, (uint8_t)(v >> 8), (uint8_t)(v >> 16), (uint8_t)(v >> 24) };
+    return fwrite(b, 1, 4, out) == 4 ? 0 : -1;
+}
+
+static int read_u32(FILE *in, uint32_t *v)
+{
+    uint8_t b[4];
+    if(fread(b, 1, 4, in) != 4) return -1;
+    *v = (uint32_t)b[0] | ((uint32_t)b[1] << 8) | ((uint32_t)b[2] << 16) | ((uint32_t)b[3] << 24);
+    return 0;
+}
+
+FILE *bp_dump_begin(const char *path, unsigned int num_tables)
+{
+    FILE *out = fopen(path, "wb");
+    if(out == NULL) return NULL;
+    if(fwrite(BP_DUMP_MAGIC, 1, BP_DUMP_MAGIC_LEN, out) != BP_DUMP_MAGIC_LEN || write_u32(out, num_tables) != 0) {
+        fclose(out);
+        return NULL;
+    }
+    return out;
+}
+
+int bp_dump_add(FILE *out, const char *name, const uint8_t *table, unsigned long int bits)
+{
+    char padded[BP_DUMP_NAME_LEN];
+    memset(padded, 0, sizeof(padded));
+    memcpy(padded, name, strnlen(name, BP_DUMP_NAME_LEN));
+    if(fwrite(padded, 1, BP_DUMP_NAME_LEN, out) != BP_DUMP_NAME_LEN || write_u32(out, (uint32_t)bits) != 0)
+        return -1;
+
+    unsigned long int size = 1UL << bits;
+    return fwrite(table, 1, size, out) == size ? 0 : -1;
+}
+
+int bp_dump_end(FILE *out)
+{
+    return fclose(out) == 0 ? 0 : -1;
+}
+
+int bp_dump_read(const char *path, bp_dump *dump)
+{
+    memset(dump, 0, sizeof(*dump));
+    FILE *in = fopen(path, "rb");
+    if(in == NULL) return -1;
+
+    char magic[BP_DUMP_MAGIC_LEN];
+    uint32_t count;
+    if(fread(magic, 1, BP_DUMP_MAGIC_LEN, in) != BP_DUMP_MAGIC_LEN ||
+       memcmp(magic, BP_DUMP_MAGIC, BP_DUMP_MAGIC_LEN) != 0 ||
+       read_u32(in, &count) != 0 || count > BP_DUMP_MAX_TABLES) {
+        fclose(in);
+        return -1;
+    }
+
+    for(uint32_t t = 0; t < count; t++) {
+        bp_dump_table *tab = &dump->tables[t];
+        uint32_t bits;
+        if(fread(tab->name, 1, BP_DUMP_NAME_LEN, in) != BP_DUMP_NAME_LEN ||
+           read_u32(in, &bits) != 0 || bits > 32) {
+            fclose(in);
+            bp_dump_free(dump);
+            return -1;
+        }
+        tab->name[BP_DUMP_NAME_LEN] = '\0';
+        tab->bits = bits;
+        size_t size = (size_t)1 << bits;
+        tab->counters = (uint8_t*)malloc(size);
+        dump->count = t + 1;
+        if(tab->counters == NULL || fread(tab->counters, 1, size, in) != size) {
+            fclose(in);
+            bp_dump_free(dump);
+            return -1;
+        }
+    }
+
+    fclose(in);
+    return 0;
+}
+
+void bp_dump_free(bp_dump *dump)
+{
+    for(unsigned int t = 0; t < dump->count; t++) free(dump->tables[t].counters);
+    dump->count = 0;
+}
@@ -0,0 +1,44 @@
+#ifndef BP_DUMP_H
+#define BP_DUMP_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+// FINAL CONTENTS output.  The text form is the original "%d\t%d\n" listing,
+// formatted into a large buffer instead of one printf per entry.  The binary
+// form is:
+//
+//   "BPDUMP01", u32 table count, then per table:
+//   char name[8] (NUL padded), u32 index bits, (1 << bits) one-byte counters
+//
+// All integers are little endian.
+
+#define BP_DUMP_MAGIC     "BPDUMP01"
+#define BP_DUMP_MAGIC_LEN 8
+#define BP_DUMP_NAME_LEN  8
+#define BP_DUMP_MAX_TABLES 8
+
+typedef struct bp_dump_table{
+    char               name[BP_DUMP_NAME_LEN + 1];
+    unsigned int       bits;
+    uint8_t           *counters;
+}bp_dump_table;
+
+typedef struct bp_dump{
+    unsigned int       count;
+    bp_dump_table      tables[BP_DUMP_MAX_TABLES];
+}bp_dump;
+
+// Writes "FINAL <title> CONTENTS" and one line per counter to out.
+void bp_dump_text(FILE *out, const char *title, const uint8_t *table, unsigned long int size);
+
+// Binary writer: begin, add each table, end.  Returns 0 on success.
+FILE *bp_dump_begin(const char *path, unsigned int num_tables);
+int   bp_dump_add(FILE *out, const char *name, const uint8_t *table, unsigned long int bits);
+int   bp_dump_end(FILE *out);
+
+// Reads a binary dump; returns 0 on success.  Free with bp_dump_free().
+int  bp_dump_read(const char *path, bp_dump *dump);
+void bp_dump_free(bp_dump *dump);
+
+#endif
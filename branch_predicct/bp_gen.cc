@@ -0,0 +1,119 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bp_gen.h"
+#include "bp_trace.h"
+
+const char *bp_gen_names[BP_GEN_PATTERNS] = { "biased", "loop", "correlated", "random", "aliased", "mixed" };
+
+int bp_gen_pattern(const char *name)
+{
+    for(int p = 0; p < BP_GEN_PATTERNS; p++)
+        if(strcmp(name, bp_gen_names[p]) == 0) return p;
+    return -1;
+}
+
+static inline uint64_t next_rand(uint64_t *s)
+{
+    // xorshift64*
+    uint64_t x = *s;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *s = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+// uniform in [0, 1)
+static inline double next_unit(uint64_t *s) { return (double)(next_rand(s) >> 11) * (1.0 / 9007199254740992.0); }
+
+typedef struct gen_branch{
+    unsigned long int  pc;
+    int                kind;        // pattern this branch follows
+    double             bias;        // biased/aliased: probability of taken
+    unsigned int       trip;        // loop: taken outcomes before the exit
+    unsigned int       iter;        // loop: position in the current trip
+    unsigned int       chain;       // correlated leader: followers, 1..4
+    int                invert;      // as a follower: repeat or invert the leader
+}gen_branch;
+
+int bp_gen_write(const char *path, int pattern, unsigned long int num_branches, unsigned long int num_static,
+                 uint64_t seed, int binary)
+{
+    if(num_static == 0) return -1;
+
+    uint64_t s = seed * 0x9E3779B97F4A7C15ULL + 1;
+    gen_branch *br = (gen_branch*)malloc(num_static * sizeof(gen_branch));
+    for(unsigned long int i = 0; i < num_static; i++) {
+        gen_branch *b = &br[i];
+        static const int mixed[3] = { BP_GEN_BIASED, BP_GEN_LOOP, BP_GEN_CORRELATED };
+        b->kind = (pattern == BP_GEN_MIXED) ? mixed[next_rand(&s) % 3] : pattern;
+        if(pattern == BP_GEN_ALIASED) {
+            b->pc = 0x400000UL + i * 0x10000UL;
+            b->bias = (i & 1) ? 0.05 : 0.95;
+        } else {
+            b->pc = 0x400000UL + i * 0x24UL;
+            b->bias = 0.70 + 0.29 * next_unit(&s);
+            if(next_rand(&s) & 1) b->bias = 1.0 - b->bias;
+        }
+        b->trip = 2 + (unsigned int)(next_rand(&s) % 63);
+        b->iter = 0;
+        b->chain = 1 + (unsigned int)(next_rand(&s) % 4);
+        b->invert = (int)(next_rand(&s) & 1);
+    }
+
+    static bp_trace_writer w;
+    if(bp_trace_create(&w, path, binary, 0) != 0) {
+        free(br);
+        return -1;
+    }
+
+    bp_record rec;
+    rec.target = 0;
+    rec.type = 0;
+    gen_branch *cur = NULL;
+    unsigned int chain = 0;
+    int leader = 0;
+    for(unsigned long int n = 0; n < num_branches; n++) {
+        gen_branch *b;
+        int taken;
+        if(chain > 0) {
+            // followers of a correlated leader are the next static branches
+            b = cur = &br[(unsigned long int)(cur - br + 1) % num_static];
+            taken = leader ^ b->invert;
+            if(next_unit(&s) < 0.02) taken = !taken;
+            chain--;
+        } else {
+            // a loop branch keeps running until its exit; otherwise pick afresh
+            if(cur == NULL || cur->kind != BP_GEN_LOOP || cur->iter == 0)
+                cur = &br[next_rand(&s) % num_static];
+            b = cur;
+            switch(b->kind) {
+            case BP_GEN_LOOP:
+                taken = (b->iter < b->trip);
+                b->iter = taken ? b->iter + 1 : 0;
+                break;
+            case BP_GEN_CORRELATED:
+                taken = leader = (int)(next_rand(&s) & 1);
+                chain = b->chain;
+                break;
+            case BP_GEN_RANDOM:
+                taken = (int)(next_rand(&s) & 1);
+                break;
+            default:
+                taken = (next_unit(&s) < b->bias);
+                break;
+            }
+        }
+        rec.pc = b->pc;
+        rec.taken = taken;
+        if(bp_trace_write(&w, &rec) != 0) {
+            bp_trace_finish(&w);
+            free(br);
+            return -1;
+        }
+    }
+
+    free(br);
+    return bp_trace_finish(&w);
+}
@@ -0,0 +1,35 @@
+#ifndef BP_GEN_H
+#define BP_GEN_H
+
+#include <stdint.h>
+
+// Synthetic branch trace generator.  Each pattern exercises one thing a
+// direction predictor has to get right:
+//
+//   biased      every static branch goes one way with a fixed probability
+//               between 70% and 99%
+//   loop        loop branches with fixed trip counts between 2 and 64
+//   correlated  a branch with a random outcome, followed by the next one to
+//               four static branches, each repeating or inverting that
+//               outcome (2% noise); only global history predicts them
+//   random      50/50 outcomes; nothing to learn
+//   aliased     like biased, but the static branches are spaced 64KB apart
+//               so they collide in any table indexed by fewer than 14 PC
+//               bits, and neighbours are biased in opposite directions
+//   mixed       each static branch is biased, loop or correlated
+//
+// Output is deterministic for a given pattern, size, static count and seed.
+
+enum { BP_GEN_BIASED, BP_GEN_LOOP, BP_GEN_CORRELATED, BP_GEN_RANDOM, BP_GEN_ALIASED, BP_GEN_MIXED, BP_GEN_PATTERNS };
+
+extern const char *bp_gen_names[BP_GEN_PATTERNS];
+
+// Returns the pattern for a name, or -1.
+int bp_gen_pattern(const char *name);
+
+// Writes num_branches dynamic branches over num_static static branches;
+// returns 0 on success.
+int bp_gen_write(const char *path, int pattern, unsigned long int num_branches, unsigned long int num_static,
+                 uint64_t seed, int binary);
+
+#endif
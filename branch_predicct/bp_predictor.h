@@ -0,0 +1,467 @@
+#ifndef BP_PREDICTOR_H
+#define BP_PREDICTOR_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sim_bp.h"
+
+// Header-level branch predictor library: the bimodal/gshare/hybrid direction
+// predictor of sim, loop predictor and statistical corrector add-ons that
+// refine its prediction, a set-associative branch target buffer and a return
+// address stack.  A trace-driven run calls, per conditional branch,
+//
+//     bp_lookup l;
+//     int prediction = bp.predict(pc, &l);
+//     bp.update(l, taken);
+//     bp.update_history(taken);
+//
+// A core model that fetches past unresolved branches instead pushes the
+// predicted outcome with update_history() at fetch, saves
+// checkpoint_history() beforehand, and on a misprediction calls
+// restore_history() followed by update_history(actual outcome).  update()
+// trains the entries recorded in the lookup, so it is unaffected by any
+// history movement between predict and update.
+
+enum { BP_BIMODAL, BP_GSHARE, BP_HYBRID };
+
+enum { BR_COND, BR_JUMP, BR_INDIRECT, BR_CALL, BR_RETURN };
+
+typedef uint32_t bp_history;
+
+// What predict() looked at and decided.
+typedef struct bp_lookup{
+    uint32_t  idx_gshare;
+    uint32_t  idx_bimodal;
+    uint32_t  idx_chooser;
+    int       gshare_pred;
+    int       bimodal_pred;
+    int       use_gshare;
+    int       counter;             // counter behind the prediction (0..3)
+    int       prediction;
+}bp_lookup;
+
+// 2-bit counter transitions: bp_counter_step[ctr][taken] and, for the
+// chooser, bp_chooser_step[ctr][1 + gshare correct - bimodal correct].
+static const uint8_t bp_counter_step[4][2] = { {0, 1}, {0, 2}, {1, 3}, {2, 3} };
+static const uint8_t bp_chooser_step[4][3] = { {0, 0, 1}, {0, 1, 2}, {1, 2, 3}, {2, 3, 3} };
+
+class BranchPredictor {
+public:
+    int         type;
+    bp_params   params;
+    uint8_t    *bimodal_table;     // 1 << M2 counters, NULL for gshare
+    uint8_t    *gshare_table;      // 1 << M1 counters, NULL for bimodal
+    uint8_t    *chooser_table;     // 1 << K counters, hybrid only
+    bp_history  ghr;
+
+    // params.bp_name selects the predictor: "bimodal" (M2), "gshare" (M1, N)
+    // or "hybrid" (K, M1, N, M2).
+    explicit BranchPredictor(const bp_params &p) {
+        params = p;
+        bimodal_table = gshare_table = chooser_table = NULL;
+        ghr = 0;
+        if(strcmp(p.bp_name, "bimodal") == 0) type = BP_BIMODAL;
+        else if(strcmp(p.bp_name, "gshare") == 0) type = BP_GSHARE;
+        else type = BP_HYBRID;
+
+        if(type != BP_GSHARE) bimodal_table = new_table(p.M2, 2);
+        if(type != BP_BIMODAL) gshare_table = new_table(p.M1, 2);
+        if(type == BP_HYBRID) chooser_table = new_table(p.K, 1);
+
+        mask_bimodal = (type != BP_GSHARE) ? (uint32_t)((1UL << p.M2) - 1) : 0;
+        mask_gshare  = (type != BP_BIMODAL) ? (uint32_t)((1UL << p.M1) - 1) : 0;
+        mask_chooser = (type == BP_HYBRID) ? (uint32_t)((1UL << p.K) - 1) : 0;
+        shift = (type != BP_BIMODAL) ? (uint32_t)(p.M1 - p.N) : 0;
+        hbit  = (type != BP_BIMODAL && p.N > 0) ? (uint32_t)(1UL << (p.N - 1)) : 0;
+    }
+
+    ~BranchPredictor() {
+        free(bimodal_table);
+        free(gshare_table);
+        free(chooser_table);
+    }
+
+    BranchPredictor(const BranchPredictor&) = delete;
+    BranchPredictor &operator=(const BranchPredictor&) = delete;
+
+    inline int predict(unsigned long int pc, bp_lookup *l) const {
+        uint32_t pcw = (uint32_t)(pc >> 2);
+        // ((pc_upper ^ ghr) << (M1 - N)) | pc_lower, written as one xor
+        l->idx_gshare  = (pcw & mask_gshare) ^ (ghr << shift);
+        l->idx_bimodal = pcw & mask_bimodal;
+        l->idx_chooser = pcw & mask_chooser;
+        if(type == BP_BIMODAL) {
+            l->counter = bimodal_table[l->idx_bimodal];
+            l->prediction = l->bimodal_pred = l->counter >> 1;
+            l->gshare_pred = l->use_gshare = 0;
+        } else if(type == BP_GSHARE) {
+            l->counter = gshare_table[l->idx_gshare];
+            l->prediction = l->gshare_pred = l->counter >> 1;
+            l->bimodal_pred = 0;
+            l->use_gshare = 1;
+        } else {
+            uint8_t gc = gshare_table[l->idx_gshare];
+            uint8_t bc = bimodal_table[l->idx_bimodal];
+            l->gshare_pred  = gc >> 1;
+            l->bimodal_pred = bc >> 1;
+            l->use_gshare   = chooser_table[l->idx_chooser] >> 1;
+            l->counter      = l->use_gshare ? gc : bc;
+            l->prediction   = l->counter >> 1;
+        }
+        return l->prediction;
+    }
+
+    // Trains the counters predict() used.  hybrid trains only the component
+    // the chooser selected, then moves the chooser toward whichever component
+    // alone was right.
+    inline void update(const bp_lookup &l, int taken) {
+        if(type == BP_BIMODAL) {
+            uint8_t *c = &bimodal_table[l.idx_bimodal];
+            *c = bp_counter_step[*c][taken];
+        } else if(type == BP_GSHARE) {
+            uint8_t *c = &gshare_table[l.idx_gshare];
+            *c = bp_counter_step[*c][taken];
+        } else {
+            uint8_t *c = l.use_gshare ? &gshare_table[l.idx_gshare] : &bimodal_table[l.idx_bimodal];
+            *c = bp_counter_step[*c][taken];
+            uint8_t *ch = &chooser_table[l.idx_chooser];
+            *ch = bp_chooser_step[*ch][1 + (l.gshare_pred == taken) - (l.bimodal_pred == taken)];
+        }
+    }
+
+    // Shifts an outcome into the global history (no-op without history).
+    inline void update_history(int taken) { ghr = (ghr >> 1) | (hbit & (0U - (uint32_t)taken)); }
+
+    inline bp_history checkpoint_history() const { return ghr; }
+    inline void restore_history(bp_history h) { ghr = h; }
+
+private:
+    uint32_t mask_bimodal, mask_gshare, mask_chooser;
+    uint32_t shift, hbit;
+
+    static uint8_t *new_table(unsigned long int bits, int init) {
+        uint8_t *t = (uint8_t*)malloc(1UL << bits);
+        memset(t, init, 1UL << bits);
+        return t;
+    }
+};
+
+// Loop predictor: 4-way tagged entries that learn the trip count of branches
+// which go one way a fixed number of times and then the other way once.  An
+// entry is allocated when the direction predictor mispredicts a branch that
+// has none, and predicts only once the same trip count has been seen
+// LOOP_CONF_MAX times in a row.
+#define LOOP_WAYS      4
+#define LOOP_CONF_MAX  3
+#define LOOP_AGE_MAX   7
+#define LOOP_ITER_MAX  0xffff
+
+typedef struct loop_lookup{
+    int       way;                 // -1 on a tag miss
+    uint32_t  set;
+    int       confident;
+    int       prediction;
+}loop_lookup;
+
+class LoopPredictor {
+public:
+    struct entry {
+        uint16_t  tag;
+        uint16_t  past_iter;       // trip count: body outcomes before the exit
+        uint16_t  current_iter;    // body outcomes since the last exit
+        uint8_t   conf;
+        uint8_t   age;
+        uint8_t   dir;             // body direction
+        uint8_t   valid;
+    };
+
+    unsigned int  sets;
+    entry        *entries;
+
+    // num_entries must be a power of two and at least LOOP_WAYS
+    explicit LoopPredictor(unsigned int num_entries) {
+        sets = num_entries / LOOP_WAYS;
+        entries = (entry*)calloc(num_entries, sizeof(entry));
+    }
+    ~LoopPredictor() { free(entries); }
+
+    LoopPredictor(const LoopPredictor&) = delete;
+    LoopPredictor &operator=(const LoopPredictor&) = delete;
+
+    // Returns 1 and sets l->prediction when a confident entry exists.
+    inline int predict(unsigned long int pc, loop_lookup *l) const {
+        l->set = set_of(pc);
+        uint16_t tag = tag_of(pc);
+        const entry *set = &entries[l->set * LOOP_WAYS];
+        l->way = -1;
+        l->confident = 0;
+        l->prediction = 0;
+        for(int w = 0; w < LOOP_WAYS; w++) {
+            if(set[w].valid && set[w].tag == tag) {
+                const entry &e = set[w];
+                l->way = w;
+                l->confident = (e.conf == LOOP_CONF_MAX);
+                l->prediction = (e.current_iter == e.past_iter) ? !e.dir : e.dir;
+                break;
+            }
+        }
+        return l->confident;
+    }
+
+    // base_correct: whether the prediction the loop predictor would have
+    // overridden was right; drives allocation and the usefulness age.
+    inline void update(unsigned long int pc, const loop_lookup &l, int taken, int base_correct) {
+        entry *set = &entries[l.set * LOOP_WAYS];
+        if(l.way >= 0) {
+            entry &e = set[l.way];
+            if(l.confident && l.prediction != taken) {
+                e.valid = 0;
+                return;
+            }
+            if(l.confident && !base_correct && e.age < LOOP_AGE_MAX) e.age++;
+            if(taken == e.dir) {
+                if(e.current_iter == LOOP_ITER_MAX) {
+                    e.valid = 0;
+                    return;
+                }
+                e.current_iter++;
+                // ran past the learned trip count: relearn it at the next exit
+                if(e.past_iter != 0 && e.current_iter > e.past_iter) {
+                    e.past_iter = 0;
+                    e.conf = 0;
+                }
+            } else {
+                if(e.current_iter == 0) {
+                    e.valid = 0;       // no body between two exits: not a loop
+                    return;
+                }
+                if(e.current_iter == e.past_iter) {
+                    if(e.conf < LOOP_CONF_MAX) e.conf++;
+                } else {
+                    e.past_iter = e.current_iter;
+                    e.conf = 0;
+                }
+                e.current_iter = 0;
+            }
+        } else if(!base_correct) {
+            entry *victim = NULL;
+            for(int w = 0; w < LOOP_WAYS && !victim; w++)
+                if(!set[w].valid || set[w].age == 0) victim = &set[w];
+            if(!victim) {
+                for(int w = 0; w < LOOP_WAYS; w++) set[w].age--;
+                return;
+            }
+            // the mispredicted outcome is taken to be a loop exit
+            victim->valid = 1;
+            victim->tag = tag_of(pc);
+            victim->dir = (uint8_t)!taken;
+            victim->past_iter = 0;
+            victim->current_iter = 0;
+            victim->conf = 0;
+            victim->age = LOOP_AGE_MAX;
+        }
+    }
+
+private:
+    // the set index folds in the tag bits so that branches a power of two
+    // apart do not all land in one set
+    inline uint32_t set_of(unsigned long int pc) const { return (uint32_t)(((pc >> 2) ^ ((pc >> 2) / sets)) & (sets - 1)); }
+    inline uint16_t tag_of(unsigned long int pc) const { return (uint16_t)((pc >> 2) / sets); }
+};
+
+// Statistical corrector: sums signed counters from a bias table, indexed by
+// PC and the counter behind the base prediction, and from tables indexed by
+// PC hashed with global history of increasing length.  When the sum
+// confidently disagrees with the base prediction the prediction is inverted.
+// The threshold adapts as in O-GEHL.
+#define SC_TABLES   4
+#define SC_CTR_MAX  31
+#define SC_CTR_MIN  (-32)
+
+typedef struct sc_lookup{
+    uint32_t  idx[SC_TABLES];
+    int       sum;
+    int       base_prediction;
+    int       prediction;
+}sc_lookup;
+
+class StatisticalCorrector {
+public:
+    unsigned int  bits;
+    int8_t       *tables[SC_TABLES];
+    uint64_t      history;
+    int           theta;
+
+    explicit StatisticalCorrector(unsigned int index_bits) {
+        bits = index_bits;
+        for(int t = 0; t < SC_TABLES; t++) tables[t] = (int8_t*)calloc(1UL << bits, 1);
+        history = 0;
+        theta = 2 * SC_TABLES + 2;
+        tc = 0;
+    }
+    ~StatisticalCorrector() { for(int t = 0; t < SC_TABLES; t++) free(tables[t]); }
+
+    StatisticalCorrector(const StatisticalCorrector&) = delete;
+    StatisticalCorrector &operator=(const StatisticalCorrector&) = delete;
+
+    // Returns the corrected prediction for a base prediction made from
+    // 2-bit counter value counter.
+    inline int predict(unsigned long int pc, int counter, sc_lookup *l) const {
+        static const unsigned int lengths[SC_TABLES] = { 0, 5, 11, 21 };
+        uint32_t mask = (uint32_t)((1UL << bits) - 1);
+        uint32_t pcw = (uint32_t)(pc >> 2);
+        l->idx[0] = ((pcw << 2) | (uint32_t)counter) & mask;
+        for(int t = 1; t < SC_TABLES; t++)
+            l->idx[t] = (pcw ^ (pcw >> bits) ^ fold(history & ((1ULL << lengths[t]) - 1))) & mask;
+        int sum = 0;
+        for(int t = 0; t < SC_TABLES; t++) sum += 2 * tables[t][l->idx[t]] + 1;
+        l->sum = sum;
+        l->base_prediction = counter >> 1;
+        l->prediction = ((sum >= 0) != l->base_prediction && abs(sum) >= theta) ? (sum >= 0) : l->base_prediction;
+        return l->prediction;
+    }
+
+    inline void update(const sc_lookup &l, int taken) {
+        int wrong = ((l.sum >= 0) != taken);
+        if(wrong || abs(l.sum) < theta) {
+            for(int t = 0; t < SC_TABLES; t++) {
+                int8_t *c = &tables[t][l.idx[t]];
+                if(taken) { if(*c < SC_CTR_MAX) (*c)++; }
+                else      { if(*c > SC_CTR_MIN) (*c)--; }
+            }
+            if(wrong) {
+                if(++tc >= 32) { theta++; tc = 0; }
+            } else {
+                if(--tc <= -32) { if(theta > 1) theta--; tc = 0; }
+            }
+        }
+        history = (history << 1) | (uint64_t)taken;
+    }
+
+private:
+    int tc;
+
+    inline uint32_t fold(uint64_t h) const {
+        uint32_t f = 0;
+        for(; h; h >>= bits) f ^= (uint32_t)h;
+        return f;
+    }
+};
+
+// Set-associative branch target buffer with LRU replacement, indexed by
+// (pc >> 2) and tagged with the remaining PC bits.
+class BranchTargetBuffer {
+public:
+    struct entry {
+        unsigned long int  tag;
+        unsigned long int  target;
+        unsigned long int  last_use;
+        int                type;
+        int                valid;
+    };
+
+    unsigned int  sets, ways;
+    entry        *entries;
+
+    // entries and ways must be powers of two, ways <= entries
+    BranchTargetBuffer(unsigned int num_entries, unsigned int num_ways) {
+        ways = num_ways;
+        sets = num_entries / num_ways;
+        entries = (entry*)calloc(num_entries, sizeof(entry));
+        clock = 0;
+    }
+    ~BranchTargetBuffer() { free(entries); }
+
+    BranchTargetBuffer(const BranchTargetBuffer&) = delete;
+    BranchTargetBuffer &operator=(const BranchTargetBuffer&) = delete;
+
+    // Returns 1 and fills target/type on a hit.
+    inline int lookup(unsigned long int pc, unsigned long int *target, int *type) {
+        entry *set = &entries[set_of(pc) * ways];
+        unsigned long int tag = tag_of(pc);
+        for(unsigned int w = 0; w < ways; w++) {
+            if(set[w].valid && set[w].tag == tag) {
+                set[w].last_use = ++clock;
+                *target = set[w].target;
+                *type = set[w].type;
+                return 1;
+            }
+        }
+        return 0;
+    }
+
+    // Installs or refreshes the entry for pc, evicting the LRU way.
+    inline void update(unsigned long int pc, unsigned long int target, int type) {
+        entry *set = &entries[set_of(pc) * ways];
+        unsigned long int tag = tag_of(pc);
+        entry *victim = NULL;
+        for(unsigned int w = 0; w < ways && !victim; w++)
+            if(set[w].valid && set[w].tag == tag) victim = &set[w];
+        if(!victim) {
+            victim = &set[0];
+            for(unsigned int w = 0; w < ways; w++) {
+                if(!set[w].valid) { victim = &set[w]; break; }
+                if(set[w].last_use < victim->last_use) victim = &set[w];
+            }
+        }
+        victim->valid = 1;
+        victim->tag = tag;
+        victim->target = target;
+        victim->type = type;
+        victim->last_use = ++clock;
+    }
+
+private:
+    unsigned long int clock;
+
+    inline unsigned long int set_of(unsigned long int pc) const { return (pc >> 2) & (sets - 1); }
+    inline unsigned long int tag_of(unsigned long int pc) const { return (pc >> 2) / sets; }
+};
+
+// Circular return address stack; a push onto a full stack overwrites the
+// oldest entry, a pop from an empty one predicts 0.
+class ReturnAddressStack {
+public:
+    typedef struct checkpoint{
+        unsigned int       top;
+        unsigned int       count;
+        unsigned long int  top_value;
+    }checkpoint;
+
+    unsigned int        depth;
+    unsigned long int  *stack;
+
+    explicit ReturnAddressStack(unsigned int d) {
+        depth = d;
+        stack = (unsigned long int*)calloc(d, sizeof(unsigned long int));
+        top = count = 0;
+    }
+    ~ReturnAddressStack() { free(stack); }
+
+    ReturnAddressStack(const ReturnAddressStack&) = delete;
+    ReturnAddressStack &operator=(const ReturnAddressStack&) = delete;
+
+    inline void push(unsigned long int return_addr) {
+        top = (top + 1) % depth;
+        stack[top] = return_addr;
+        if(count < depth) count++;
+    }
+
+    inline unsigned long int pop() {
+        if(count == 0) return 0;
+        unsigned long int v = stack[top];
+        top = (top + depth - 1) % depth;
+        count--;
+        return v;
+    }
+
+    // Pointer-and-top-value repair, enough to undo one wrong-path push or pop.
+    inline checkpoint save() const { checkpoint c = { top, count, stack[top] }; return c; }
+    inline void restore(const checkpoint &c) { top = c.top; count = c.count; stack[top] = c.top_value; }
+
+private:
+    unsigned int top, count;
+};
+
+#endif
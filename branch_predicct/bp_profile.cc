@@ -0,0 +1,90 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bp_profile.h"
+
+void bp_profile_init(bp_profile *prof)
+{
+    memset(prof, 0, sizeof(*prof));
+    prof->capacity = 1 << 12;
+    prof->entries = (bp_profile_entry*)calloc(prof->capacity, sizeof(bp_profile_entry));
+    prof->zero_entry.last_taken = -1;
+}
+
+void bp_profile_free(bp_profile *prof)
+{
+    free(prof->entries);
+    prof->entries = NULL;
+}
+
+void bp_profile_grow(bp_profile *prof)
+{
+    bp_profile_entry *old = prof->entries;
+    unsigned long int old_capacity = prof->capacity;
+
+    prof->capacity *= 2;
+    prof->entries = (bp_profile_entry*)calloc(prof->capacity, sizeof(bp_profile_entry));
+    prof->used = 0;
+    for(unsigned long int i = 0; i < old_capacity; i++) {
+        if(old[i].pc == 0) continue;
+        bp_profile_entry *e = bp_profile_lookup(prof, old[i].pc);
+        *e = old[i];
+    }
+    free(old);
+}
+
+static int by_mispredictions(const void *a, const void *b)
+{
+    const bp_profile_entry *x = *(const bp_profile_entry* const*)a;
+    const bp_profile_entry *y = *(const bp_profile_entry* const*)b;
+    if(x->mispredictions != y->mispredictions) return (x->mispredictions < y->mispredictions) ? 1 : -1;
+    if(x->executions != y->executions) return (x->executions < y->executions) ? 1 : -1;
+    return (x->pc > y->pc) ? 1 : -1;
+}
+
+void bp_profile_report(const bp_profile *prof, unsigned long int top_n, int hybrid)
+{
+    unsigned long int count = prof->used + (prof->zero_seen ? 1 : 0);
+    const bp_profile_entry **sorted = (const bp_profile_entry**)malloc((count + 1) * sizeof(bp_profile_entry*));
+    unsigned long int n = 0;
+    unsigned long int total_mispredictions = 0;
+
+    for(unsigned long int i = 0; i < prof->capacity; i++)
+        if(prof->entries[i].pc != 0) sorted[n++] = &prof->entries[i];
+    if(prof->zero_seen) sorted[n++] = &prof->zero_entry;
+    for(unsigned long int i = 0; i < n; i++) total_mispredictions += sorted[i]->mispredictions;
+    qsort(sorted, n, sizeof(sorted[0]), by_mispredictions);
+
+    if(top_n > n) top_n = n;
+    printf("BRANCH PROFILE (top %lu of %lu static branches by mispredictions)\n", top_n, n);
+    printf("pc\texecutions\tmispredictions\tmisprediction rate\tshare of mispredictions\ttaken rate\ttransitions");
+    if(hybrid) printf("\tgshare chosen");
+    printf("\n");
+    for(unsigned long int i = 0; i < top_n; i++) {
+        const bp_profile_entry *e = sorted[i];
+        printf("%lx\t%lu\t%lu\t%.2f%%\t%.2f%%\t%.2f%%\t%lu",
+               e->pc, e->executions, e->mispredictions,
+               (double)e->mispredictions / e->executions * 100,
+               total_mispredictions ? (double)e->mispredictions / total_mispredictions * 100 : 0.0,
+               (double)e->taken / e->executions * 100,
+               e->transitions);
+        if(hybrid) printf("\t%.2f%%", (double)e->gshare_chosen / e->executions * 100);
+        printf("\n");
+    }
+
+    if(hybrid) {
+        const bp_chooser_stats *c = &prof->chooser;
+        unsigned long int total = c->chose_gshare + c->chose_bimodal;
+        double scale = total ? 100.0 / total : 0.0;
+        printf("CHOOSER STATISTICS\n");
+        printf("chose gshare:\t\t\t%lu (%.2f%%)\n", c->chose_gshare, c->chose_gshare * scale);
+        printf("chose bimodal:\t\t\t%lu (%.2f%%)\n", c->chose_bimodal, c->chose_bimodal * scale);
+        printf("gshare correct:\t\t\t%lu (%.2f%%)\n", c->gshare_correct, c->gshare_correct * scale);
+        printf("bimodal correct:\t\t%lu (%.2f%%)\n", c->bimodal_correct, c->bimodal_correct * scale);
+        printf("both correct:\t\t\t%lu (%.2f%%)\n", c->both_correct, c->both_correct * scale);
+        printf("both wrong:\t\t\t%lu (%.2f%%)\n", c->both_wrong, c->both_wrong * scale);
+        printf("chose the wrong component:\t%lu (%.2f%%)\n", c->wrong_choice, c->wrong_choice * scale);
+    }
+
+    free(sorted);
+}
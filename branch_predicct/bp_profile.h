@@ -0,0 +1,101 @@
+#ifndef BP_PROFILE_H
+#define BP_PROFILE_H
+
+#include <stdint.h>
+
+// Per-static-branch profile, kept in an open-addressing (linear probing)
+// hash table keyed by PC.  Only touched when sim runs with --profile.
+
+typedef struct bp_profile_entry{
+    unsigned long int  pc;          // 0 marks an empty slot (see zero_seen)
+    unsigned long int  executions;
+    unsigned long int  mispredictions;
+    unsigned long int  taken;
+    unsigned long int  transitions;  // outcome differs from the previous one
+    unsigned long int  gshare_chosen;
+    int                last_taken;
+}bp_profile_entry;
+
+typedef struct bp_chooser_stats{
+    unsigned long int  chose_gshare;
+    unsigned long int  chose_bimodal;
+    unsigned long int  gshare_correct;
+    unsigned long int  bimodal_correct;
+    unsigned long int  both_correct;
+    unsigned long int  both_wrong;
+    unsigned long int  wrong_choice;  // chosen component wrong, other right
+}bp_chooser_stats;
+
+typedef struct bp_profile{
+    bp_profile_entry  *entries;
+    unsigned long int  capacity;    // power of two
+    unsigned long int  used;
+    bp_profile_entry   zero_entry;  // branch at PC 0, if the trace has one
+    int                zero_seen;
+    bp_chooser_stats   chooser;
+}bp_profile;
+
+void bp_profile_init(bp_profile *prof);
+void bp_profile_free(bp_profile *prof);
+void bp_profile_grow(bp_profile *prof);
+
+// Prints the top_n static branches by mispredictions, plus the chooser
+// statistics when hybrid is set.
+void bp_profile_report(const bp_profile *prof, unsigned long int top_n, int hybrid);
+
+static inline bp_profile_entry *bp_profile_lookup(bp_profile *prof, unsigned long int pc)
+{
+    if(pc == 0) {
+        prof->zero_seen = 1;
+        return &prof->zero_entry;
+    }
+    unsigned long int mask = prof->capacity - 1;
+    unsigned long int h = (pc >> 2) * 0x9E3779B97F4A7C15UL;
+    unsigned long int i = (h ^ (h >> 32)) & mask;
+    for(;;) {
+        bp_profile_entry *e = &prof->entries[i];
+        if(e->pc == pc) return e;
+        if(e->pc == 0) {
+            if(2 * (prof->used + 1) > prof->capacity) {
+                bp_profile_grow(prof);
+                return bp_profile_lookup(prof, pc);
+            }
+            e->pc = pc;
+            e->last_taken = -1;
+            prof->used++;
+            return e;
+        }
+        i = (i + 1) & mask;
+    }
+}
+
+static inline bp_profile_entry *bp_profile_record(bp_profile *prof, unsigned long int pc, int taken, int prediction)
+{
+    bp_profile_entry *e = bp_profile_lookup(prof, pc);
+    e->executions++;
+    e->taken += taken;
+    e->mispredictions += (prediction != taken);
+    e->transitions += (e->last_taken >= 0 && e->last_taken != taken);
+    e->last_taken = taken;
+    return e;
+}
+
+static inline void bp_profile_record_chooser(bp_profile *prof, bp_profile_entry *e, int use_gshare,
+                                             int gshare_pred, int bimodal_pred, int taken)
+{
+    bp_chooser_stats *c = &prof->chooser;
+    int g = (gshare_pred == taken), b = (bimodal_pred == taken);
+    if(use_gshare) {
+        c->chose_gshare++;
+        e->gshare_chosen++;
+    } else {
+        c->chose_bimodal++;
+    }
+    c->gshare_correct += g;
+    c->bimodal_correct += b;
+    c->both_correct += (g && b);
+    c->both_wrong += (!g && !b);
+    c->wrong_choice += use_gshare ? (!g && b) : (g && !b);
+}
+
+#endif
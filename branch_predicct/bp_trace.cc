@@ -0,0 +1,144 @@
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "bp_trace.h"
+
+int bp_trace_open(bp_trace *trace, const char *path)
+{
+    memset(trace, 0, sizeof(*trace));
+
+    int fd = open(path, O_RDONLY);
+    if(fd < 0) return -1;
+
+    struct stat st;
+    if(fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+    trace->size = (size_t)st.st_size;
+
+    if(trace->size > 0) {
+        void *m = mmap(NULL, trace->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(m == MAP_FAILED) {
+            close(fd);
+            return -1;
+        }
+        madvise(m, trace->size, MADV_SEQUENTIAL);
+        trace->data = (const uint8_t*)m;
+    }
+    close(fd);
+
+    if(trace->size >= BP_TRACE_HDR_LEN) {
+        trace->extended = (memcmp(trace->data, BP_TRACE_MAGIC_EXT, BP_TRACE_MAGIC_LEN) == 0);
+        trace->binary = trace->extended || (memcmp(trace->data, BP_TRACE_MAGIC, BP_TRACE_MAGIC_LEN) == 0);
+    }
+    bp_trace_rewind(trace);
+    return 0;
+}
+
+void bp_trace_rewind(bp_trace *trace)
+{
+    trace->error = NULL;
+    trace->prev_pc = 0;
+    trace->line = 1;
+    if(trace->binary) {
+        uint64_t count = 0;
+        for(int i = 0; i < 8; i++)
+            count |= (uint64_t)trace->data[BP_TRACE_MAGIC_LEN + i] << (8 * i);
+        trace->count = trace->remaining = count;
+        trace->pos = BP_TRACE_HDR_LEN;
+    } else {
+        trace->remaining = 0;
+        trace->pos = 0;
+    }
+}
+
+const char *bp_trace_where(const bp_trace *trace, char *buf, size_t len)
+{
+    if(trace->binary)
+        snprintf(buf, len, "record %lu (byte %zu)", (unsigned long int)(trace->count - trace->remaining), trace->pos);
+    else
+        snprintf(buf, len, "line %lu", trace->line);
+    return buf;
+}
+
+void bp_trace_close(bp_trace *trace)
+{
+    if(trace->data) munmap((void*)trace->data, trace->size);
+    trace->data = NULL;
+}
+
+static size_t put_varint(char *buf, uint64_t v)
+{
+    size_t n = 0;
+    while(v >= 0x80) {
+        buf[n++] = (char)(v | 0x80);
+        v >>= 7;
+    }
+    buf[n++] = (char)v;
+    return n;
+}
+
+static uint64_t zigzag(int64_t v) { return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63); }
+
+int bp_trace_create(bp_trace_writer *w, const char *path, int binary, int extended)
+{
+    w->out = fopen(path, "wb");
+    if(w->out == NULL) return -1;
+    w->binary = binary;
+    w->extended = extended;
+    w->count = 0;
+    w->prev_pc = 0;
+    w->len = 0;
+    if(binary) {
+        // record count is patched in by bp_trace_finish()
+        memset(w->buf, 0, BP_TRACE_HDR_LEN);
+        memcpy(w->buf, extended ? BP_TRACE_MAGIC_EXT : BP_TRACE_MAGIC, BP_TRACE_MAGIC_LEN);
+        w->len = BP_TRACE_HDR_LEN;
+    }
+    return 0;
+}
+
+int bp_trace_write(bp_trace_writer *w, const bp_record *rec)
+{
+    if(w->len > sizeof(w->buf) - 64) {
+        fwrite(w->buf, 1, w->len, w->out);
+        w->len = 0;
+    }
+    char *p = w->buf + w->len;
+    if(!w->binary) {
+        if(w->extended)
+            w->len += sprintf(p, "%lx %c %lx %c\n", rec->pc, rec->taken ? 't' : 'n', rec->target, BP_TRACE_TYPES[rec->type]);
+        else
+            w->len += sprintf(p, "%lx %c\n", rec->pc, rec->taken ? 't' : 'n');
+    } else {
+        uint64_t delta = zigzag((int64_t)((uint64_t)rec->pc - w->prev_pc));
+        if(delta >> (w->extended ? 60 : 63)) return -1;
+        if(w->extended) {
+            w->len += put_varint(p, (delta << 4) | ((uint64_t)rec->type << 1) | (uint64_t)rec->taken);
+            w->len += put_varint(w->buf + w->len, zigzag((int64_t)((uint64_t)rec->target - rec->pc)));
+        } else {
+            w->len += put_varint(p, (delta << 1) | (uint64_t)rec->taken);
+        }
+        w->prev_pc = rec->pc;
+    }
+    w->count++;
+    return 0;
+}
+
+int bp_trace_finish(bp_trace_writer *w)
+{
+    int err = (fwrite(w->buf, 1, w->len, w->out) != w->len);
+    if(w->binary) {
+        uint8_t hdr[8];
+        for(int i = 0; i < 8; i++) hdr[i] = (uint8_t)(w->count >> (8 * i));
+        err |= (fseek(w->out, BP_TRACE_MAGIC_LEN, SEEK_SET) != 0);
+        err |= (fwrite(hdr, 1, 8, w->out) != 8);
+    }
+    err |= (fclose(w->out) != 0);
+    w->out = NULL;
+    return err ? -1 : 0;
+}
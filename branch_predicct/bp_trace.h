@@ -0,0 +1,239 @@
+#ifndef BP_TRACE_H
+#define BP_TRACE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+
+// Branch trace reader.  The file is mmap'd and decoded in place; the format
+// is detected from the first bytes:
+//
+//   text:    one "<hex pc> <t|n>" record per line (the original format),
+//            optionally extended to "<hex pc> <t|n> <hex target> <type>"
+//            where type is B (conditional), J (direct jump), I (indirect
+//            jump), C (call) or R (return)
+//   binary:  "BPTRACE1", u64 record count (little endian), then one varint
+//            per record holding (zigzag(pc - previous pc) << 1) | taken
+//   binary:  "BPTRACE2" (extended), u64 record count, then per record a
+//            varint (zigzag(pc - previous pc) << 4) | (type << 1) | taken
+//            followed by a varint zigzag(target - pc)
+//
+// Records without target and type read as conditional branches with target
+// 0.  bp_trace_read() returns 1 for a record, 0 at end of trace and -1 on a
+// malformed or truncated record (bp_trace::error says why).
+
+#define BP_TRACE_MAGIC     "BPTRACE1"
+#define BP_TRACE_MAGIC_EXT "BPTRACE2"
+#define BP_TRACE_MAGIC_LEN 8
+#define BP_TRACE_HDR_LEN   16
+
+// branch types; same values as BR_* in bp_predictor.h
+#define BP_TRACE_TYPES     "BJICR"
+
+typedef struct bp_record{
+    unsigned long int  pc;
+    unsigned long int  target;
+    int                taken;
+    int                type;
+}bp_record;
+
+typedef struct bp_trace{
+    const uint8_t     *data;
+    size_t             size;
+    size_t             pos;
+    int                binary;
+    int                extended;    // binary: records carry target and type
+    uint64_t           count;       // binary: records in the header
+    uint64_t           remaining;   // binary: records left
+    uint64_t           prev_pc;     // binary: delta base
+    unsigned long int  line;        // text: current line, for errors
+    const char        *error;
+}bp_trace;
+
+int  bp_trace_open(bp_trace *trace, const char *path);
+void bp_trace_close(bp_trace *trace);
+
+// Restarts decoding from the first record.
+void bp_trace_rewind(bp_trace *trace);
+
+// Where the last error was, for messages: "line N" in a text trace, or
+// "record N (byte M)" in a binary one, counting records from 0.
+const char *bp_trace_where(const bp_trace *trace, char *buf, size_t len);
+
+static inline int bp_trace_hexval(uint8_t c)
+{
+    if(c >= '0' && c <= '9') return c - '0';
+    c |= 0x20;
+    if(c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+// Parses a hex number at *pos (optional 0x prefix); -1 if there is none.
+static inline int bp_trace_hex(const bp_trace *trace, size_t *pos, unsigned long int *value)
+{
+    const uint8_t *d = trace->data;
+    size_t end = trace->size;
+    size_t p = *pos;
+    if(p + 1 < end && d[p] == '0' && (d[p + 1] | 0x20) == 'x') p += 2;
+    unsigned long int v = 0;
+    int digits = 0, h;
+    while(p < end && (h = bp_trace_hexval(d[p])) >= 0) {
+        v = (v << 4) | (unsigned long int)h;
+        digits++;
+        p++;
+    }
+    if(digits == 0 || digits > 16) return -1;
+    *value = v;
+    *pos = p;
+    return 0;
+}
+
+static inline int bp_trace_read_text(bp_trace *trace, bp_record *rec)
+{
+    const uint8_t *d = trace->data;
+    size_t end = trace->size;
+    size_t p = trace->pos;
+
+    while(p < end && (d[p] == ' ' || d[p] == '\t' || d[p] == '\r' || d[p] == '\n')) {
+        if(d[p] == '\n') trace->line++;
+        p++;
+    }
+    if(p == end) {
+        trace->pos = p;
+        return 0;
+    }
+
+    if(bp_trace_hex(trace, &p, &rec->pc) != 0) {
+        trace->error = "bad branch address";
+        return -1;
+    }
+
+    while(p < end && (d[p] == ' ' || d[p] == '\t')) p++;
+    if(p == end || d[p] == '\n' || d[p] == '\r') {
+        trace->error = "missing branch outcome";
+        return -1;
+    }
+    rec->taken = (d[p] == 't');
+    // the outcome is one token; anything after its first character is ignored
+    while(p < end && d[p] != '\n' && d[p] != ' ' && d[p] != '\t' && d[p] != '\r') p++;
+
+    rec->target = 0;
+    rec->type = 0;
+    while(p < end && (d[p] == ' ' || d[p] == '\t')) p++;
+    if(p < end && d[p] != '\n' && d[p] != '\r') {
+        if(bp_trace_hex(trace, &p, &rec->target) != 0) {
+            trace->error = "bad branch target";
+            return -1;
+        }
+        while(p < end && (d[p] == ' ' || d[p] == '\t')) p++;
+        int type = -1;
+        for(int t = 0; p < end && BP_TRACE_TYPES[t]; t++)
+            if(d[p] == BP_TRACE_TYPES[t]) type = t;
+        if(type < 0) {
+            trace->error = "bad branch type";
+            return -1;
+        }
+        rec->type = type;
+        while(p < end && d[p] != '\n' && d[p] != ' ' && d[p] != '\t' && d[p] != '\r') p++;
+    }
+
+    trace->pos = p;
+    return 1;
+}
+
+static inline int bp_trace_varint(bp_trace *trace, uint64_t *value)
+{
+    const uint8_t *d = trace->data;
+    size_t end = trace->size;
+    size_t p = trace->pos;
+    uint64_t v = 0;
+    int s = 0;
+    for(;;) {
+        if(p == end || s > 63) {
+            trace->error = "truncated binary record";
+            return -1;
+        }
+        uint8_t b = d[p++];
+        v |= (uint64_t)(b & 0x7f) << s;
+        if(!(b & 0x80)) break;
+        s += 7;
+    }
+    trace->pos = p;
+    *value = v;
+    return 0;
+}
+
+static inline int64_t bp_trace_unzigzag(uint64_t zz) { return (int64_t)(zz >> 1) ^ -(int64_t)(zz & 1); }
+
+static inline int bp_trace_read_binary(bp_trace *trace, bp_record *rec)
+{
+    if(trace->remaining == 0) return 0;
+
+    // on an error pos is left at the start of the bad record
+    size_t start = trace->pos;
+    uint64_t v;
+    if(bp_trace_varint(trace, &v) != 0) return -1;
+    if(trace->extended) {
+        uint64_t t;
+        if(bp_trace_varint(trace, &t) != 0) {
+            trace->pos = start;
+            return -1;
+        }
+        rec->type = (int)((v >> 1) & 7);
+        if(rec->type >= (int)sizeof(BP_TRACE_TYPES) - 1) {
+            trace->error = "bad branch type";
+            trace->pos = start;
+            return -1;
+        }
+        trace->prev_pc += (uint64_t)bp_trace_unzigzag(v >> 4);
+        rec->target = (unsigned long int)(trace->prev_pc + (uint64_t)bp_trace_unzigzag(t));
+    } else {
+        trace->prev_pc += (uint64_t)bp_trace_unzigzag(v >> 1);
+        rec->type = 0;
+        rec->target = 0;
+    }
+    rec->pc = (unsigned long int)trace->prev_pc;
+    rec->taken = (int)(v & 1);
+    trace->remaining--;
+    return 1;
+}
+
+static inline int bp_trace_read(bp_trace *trace, bp_record *rec)
+{
+    if(trace->binary) return bp_trace_read_binary(trace, rec);
+    return bp_trace_read_text(trace, rec);
+}
+
+// Trace writer, for either format.  Records are buffered; the binary record
+// count is patched into the header by bp_trace_finish().
+typedef struct bp_trace_writer{
+    FILE              *out;
+    int                binary;
+    int                extended;
+    uint64_t           count;
+    uint64_t           prev_pc;
+    size_t             len;
+    char               buf[1 << 16];
+}bp_trace_writer;
+
+// Returns 0 on success; extended selects the target/type record form.
+// bp_trace_write() returns -1, writing nothing, for a binary record whose pc
+// jump does not fit beside the outcome (and type) bits of its varint: the
+// zigzagged delta must stay below 2^63, or 2^60 when extended.
+int  bp_trace_create(bp_trace_writer *w, const char *path, int binary, int extended);
+int  bp_trace_write(bp_trace_writer *w, const bp_record *rec);
+int  bp_trace_finish(bp_trace_writer *w);
+
+// Direction-only view for the plain predictor loops.
+static inline int bp_trace_next(bp_trace *trace, unsigned long int *addr, int *taken)
+{
+    bp_record rec;
+    int r = bp_trace_read(trace, &rec);
+    if(r > 0) {
+        *addr = rec.pc;
+        *taken = rec.taken;
+    }
+    return r;
+}
+
+#endif
@@ -0,0 +1,315 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "sim_bp.h"
+#include "bp_predictor.h"
+#include "bp_batch.h"
+#include "bp_trace.h"
+#include "bp_tune.h"
+
+typedef struct tune_point{
+    bp_params          params;
+    unsigned long int  bits;
+    unsigned long int  mispredictions;
+    int                alive;
+}tune_point;
+
+// Decoded branch: ((pc >> 2) << 1) | taken.  Table indices never use more
+// than 30 PC bits, so 31 bits of (pc >> 2) are enough.
+static inline unsigned long int decoded_addr(uint32_t w) { return (unsigned long int)(w >> 1) << 2; }
+
+static unsigned long int storage_bits(const bp_params *p)
+{
+    if(strcmp(p->bp_name, "bimodal") == 0) return 2 * (1UL << p->M2);
+    if(strcmp(p->bp_name, "gshare") == 0) return 2 * (1UL << p->M1) + p->N;
+    return 2 * ((1UL << p->K) + (1UL << p->M1) + (1UL << p->M2)) + p->N;
+}
+
+static void format_config(char *buf, const bp_params *p)
+{
+    if(strcmp(p->bp_name, "bimodal") == 0)
+        sprintf(buf, "bimodal %lu", p->M2);
+    else if(strcmp(p->bp_name, "gshare") == 0)
+        sprintf(buf, "gshare %lu %lu", p->M1, p->N);
+    else
+        sprintf(buf, "hybrid %lu %lu %lu %lu", p->K, p->M1, p->N, p->M2);
+}
+
+// Same prediction and update rules as BranchPredictor's hybrid, specialised
+// to the pre-decoded trace; the counter step tables keep the loop free of
+// data-dependent branches.
+static unsigned long int eval_hybrid(const bp_params *p, const uint32_t *trace, unsigned long int n)
+{
+    uint32_t mk = (1U << p->K) - 1, m1 = (1U << p->M1) - 1, m2 = (1U << p->M2) - 1;
+    uint32_t shift = p->M1 - p->N;
+    uint32_t hbit = p->N ? 1U << (p->N - 1) : 0;
+    uint8_t *chooser = (uint8_t*)malloc(mk + 1);
+    uint8_t *gshare = (uint8_t*)malloc(m1 + 1);
+    uint8_t *bimodal = (uint8_t*)malloc(m2 + 1);
+    memset(chooser, 1, mk + 1);
+    memset(gshare, 2, m1 + 1);
+    memset(bimodal, 2, m2 + 1);
+
+    uint32_t ghr = 0;
+    unsigned long int miss = 0;
+    for(unsigned long int i = 0; i < n; i++) {
+        uint32_t pc = trace[i] >> 1;
+        uint32_t taken = trace[i] & 1;
+        uint32_t ig = (pc & m1) ^ (ghr << shift);
+        uint32_t ib = pc & m2;
+        uint32_t ic = pc & mk;
+        uint32_t gp = gshare[ig] >> 1, bp = bimodal[ib] >> 1;
+        uint32_t use_gshare = chooser[ic] >> 1;
+        miss += ((use_gshare ? gp : bp) != taken);
+
+        uint8_t *ctr = use_gshare ? &gshare[ig] : &bimodal[ib];
+        *ctr = bp_counter_step[*ctr][taken];
+        ghr = (ghr >> 1) | (hbit & (0 - taken));
+        chooser[ic] = bp_chooser_step[chooser[ic]][1 + (gp == taken) - (bp == taken)];
+    }
+
+    free(chooser);
+    free(gshare);
+    free(bimodal);
+    return miss;
+}
+
+// Evaluates every live point on the first n branches.  bimodal and gshare
+// points share one lockstep pass; hybrid points run one after another.
+static void evaluate(tune_point *points, unsigned long int count, const uint32_t *trace, unsigned long int n)
+{
+    bp_params *batch_cfg = (bp_params*)malloc(count * sizeof(bp_params));
+    unsigned long int *batch_idx = (unsigned long int*)malloc(count * sizeof(unsigned long int));
+    unsigned int num_batch = 0;
+
+    for(unsigned long int i = 0; i < count; i++) {
+        if(!points[i].alive) continue;
+        if(strcmp(points[i].params.bp_name, "hybrid") == 0) {
+            points[i].mispredictions = eval_hybrid(&points[i].params, trace, n);
+        } else {
+            batch_cfg[num_batch] = points[i].params;
+            batch_idx[num_batch++] = i;
+        }
+    }
+
+    // as many passes over the trace as it takes to keep each batch's tables
+    // under BP_BATCH_MAX_ENTRIES
+    for(unsigned int first = 0; first < num_batch; ) {
+        unsigned int end = first;
+        unsigned long int total = 1;
+        while(end < num_batch && total + bp_batch_entries(&batch_cfg[end]) <= BP_BATCH_MAX_ENTRIES)
+            total += bp_batch_entries(&batch_cfg[end++]);
+        bp_batch batch;
+        if(bp_batch_init(&batch, batch_cfg + first, end - first) != 0) {
+            printf("Error: tune %s\n", batch.error);
+            exit(EXIT_FAILURE);
+        }
+        for(unsigned long int i = 0; i < n; i++)
+            bp_batch_step(&batch, decoded_addr(trace[i]), trace[i] & 1);
+        bp_batch_finish(&batch);
+        for(unsigned int j = first; j < end; j++)
+            points[batch_idx[j]].mispredictions = batch.mispredictions[j - first];
+        bp_batch_free(&batch);
+        first = end;
+    }
+
+    free(batch_cfg);
+    free(batch_idx);
+}
+
+static int by_bits(const void *a, const void *b)
+{
+    const tune_point *x = (const tune_point*)a, *y = (const tune_point*)b;
+    if(x->bits != y->bits) return (x->bits < y->bits) ? -1 : 1;
+    if(x->mispredictions != y->mispredictions) return (x->mispredictions < y->mispredictions) ? -1 : 1;
+    return 0;
+}
+
+static int by_mispredictions(const void *a, const void *b)
+{
+    const tune_point *x = *(const tune_point* const*)a, *y = *(const tune_point* const*)b;
+    if(x->mispredictions != y->mispredictions) return (x->mispredictions < y->mispredictions) ? -1 : 1;
+    if(x->bits != y->bits) return (x->bits < y->bits) ? -1 : 1;
+    return 0;
+}
+
+// Kills every live point that a point of no greater cost beats by more than
+// the margin: slack (a fraction of the better point's mispredictions) plus,
+// with noise, two standard deviations of binomial noise, so short prefixes
+// prune conservatively.  With no margin at all a point has to beat every
+// cheaper survivor outright and only one point of each cost is kept, which
+// leaves exactly the Pareto frontier.  points must be sorted by bits.
+// Returns the number of survivors.
+static unsigned long int prune(tune_point *points, unsigned long int count, double slack, int noise)
+{
+    int exact = (slack == 0.0 && !noise);
+    unsigned long int best = (unsigned long int)-1, alive = 0;
+    for(unsigned long int i = 0; i < count; ) {
+        // points of equal cost compete with each other too
+        unsigned long int j = i, group = (unsigned long int)-1;
+        for(; j < count && points[j].bits == points[i].bits; j++)
+            if(points[j].alive && points[j].mispredictions < group) group = points[j].mispredictions;
+        unsigned long int ref = (group < best) ? group : best;
+        int kept = 0;
+        for(; i < j; i++) {
+            if(!points[i].alive) continue;
+            if(exact) {
+                if(kept || points[i].mispredictions != group || group >= best) points[i].alive = 0;
+                else kept = 1, alive++;
+                continue;
+            }
+            double margin = (double)ref * slack + (noise ? 2.0 * sqrt((double)ref) : 0.0);
+            if((double)ref + margin < (double)points[i].mispredictions) points[i].alive = 0;
+            else alive++;
+        }
+        best = ref;
+    }
+    return alive;
+}
+
+int run_tune(int argc, char* argv[])
+{
+    unsigned long int prefix = 0, top = 10;
+    double slack = 0.0;
+    int nargs = 2;
+    for(int i = 2; i < argc; i++) {
+        if(strncmp(argv[i], "--prefix=", 9) == 0) prefix = strtoul(argv[i] + 9, NULL, 10);
+        else if(strncmp(argv[i], "--slack=", 8) == 0) slack = strtod(argv[i] + 8, NULL) / 100.0;
+        else if(strncmp(argv[i], "--top=", 6) == 0) top = strtoul(argv[i] + 6, NULL, 10);
+        else if(strncmp(argv[i], "--", 2) == 0) {
+            printf("Error: Unknown option %s\n", argv[i]);
+            exit(EXIT_FAILURE);
+        } else argv[nargs++] = argv[i];
+    }
+    if(nargs != 4)
+    {
+        printf("Error: tune wrong number of inputs (tune <budget bits> <tracefile> [--prefix=N] [--slack=PCT] [--top=N])\n");
+        exit(EXIT_FAILURE);
+    }
+    unsigned long int budget = strtoul(argv[2], NULL, 10);
+    char *trace_file = argv[3];
+    printf("COMMAND\n%s tune %lu %s\n", argv[0], budget, trace_file);
+
+    bp_trace trace;
+    if(bp_trace_open(&trace, trace_file) != 0)
+    {
+        printf("Error: Unable to open file %s\n", trace_file);
+        exit(EXIT_FAILURE);
+    }
+
+    // decode the trace once; every evaluation pass replays this array
+    unsigned long int len = 0, cap = 1 << 20;
+    uint32_t *decoded = (uint32_t*)malloc(cap * sizeof(uint32_t));
+    unsigned long int addr;
+    int taken, r;
+    while((r = bp_trace_next(&trace, &addr, &taken)) > 0) {
+        if(len == cap) {
+            cap *= 2;
+            decoded = (uint32_t*)realloc(decoded, cap * sizeof(uint32_t));
+        }
+        decoded[len++] = (uint32_t)(((addr >> 2) & 0x7fffffff) << 1) | (uint32_t)taken;
+    }
+    if(r < 0)
+    {
+        char where[64];
+        printf("Error: %s at %s of %s\n", trace.error, bp_trace_where(&trace, where, sizeof(where)), trace_file);
+        exit(EXIT_FAILURE);
+    }
+    bp_trace_close(&trace);
+    if(len == 0)
+    {
+        printf("Error: empty trace %s\n", trace_file);
+        exit(EXIT_FAILURE);
+    }
+
+    // enumerate everything that fits; index bits run from 1 to 30
+    unsigned long int count = 0, num_bimodal = 0, num_gshare = 0, num_hybrid = 0;
+    tune_point *points = NULL;
+    for(int pass = 0; pass < 2; pass++) {
+        count = num_bimodal = num_gshare = num_hybrid = 0;
+        for(unsigned long int m2 = 1; m2 <= 30; m2++) {
+            bp_params p = { 0, 0, m2, 0, (char*)"bimodal" };
+            if(storage_bits(&p) > budget) break;
+            if(pass) points[count].params = p;
+            count++;
+            num_bimodal++;
+        }
+        // gshare with N = 0 is bimodal with M2 = M1, so it is not repeated
+        for(unsigned long int m1 = 1; m1 <= 30; m1++)
+            for(unsigned long int n = 1; n <= m1; n++) {
+                bp_params p = { 0, m1, 0, n, (char*)"gshare" };
+                if(storage_bits(&p) > budget) continue;
+                if(pass) points[count].params = p;
+                count++;
+                num_gshare++;
+            }
+        for(unsigned long int k = 1; k <= 30; k++)
+            for(unsigned long int m1 = 1; m1 <= 30; m1++)
+                for(unsigned long int m2 = 1; m2 <= 30; m2++)
+                    for(unsigned long int n = 0; n <= m1; n++) {
+                        bp_params p = { k, m1, m2, n, (char*)"hybrid" };
+                        if(storage_bits(&p) > budget) continue;
+                        if(pass) points[count].params = p;
+                        count++;
+                        num_hybrid++;
+                    }
+        if(!pass) points = (tune_point*)calloc(count ? count : 1, sizeof(tune_point));
+    }
+    if(count == 0)
+    {
+        printf("Error: no configuration fits in %lu bits\n", budget);
+        exit(EXIT_FAILURE);
+    }
+    for(unsigned long int i = 0; i < count; i++) {
+        points[i].bits = storage_bits(&points[i].params);
+        points[i].alive = 1;
+    }
+
+    if(prefix == 0) prefix = (len / 256 > 8192) ? len / 256 : 8192;
+    if(prefix > len) prefix = len;
+
+    printf("OUTPUT\n");
+    printf("storage budget:\t\t\t%lu bits\n", budget);
+    printf("number of branches:\t\t%lu\n", len);
+    printf("configurations:\t\t\t%lu (bimodal %lu, gshare %lu, hybrid %lu)\n", count, num_bimodal, num_gshare, num_hybrid);
+
+    unsigned long int alive = count;
+    for(unsigned long int n = prefix; ; n = (n * 8 < len) ? n * 8 : len) {
+        evaluate(points, count, decoded, n);
+        qsort(points, count, sizeof(tune_point), by_bits);
+        if(n == len) break;
+        alive = prune(points, count, slack, 1);
+        printf("prefix %lu branches:\t\t%lu configurations kept\n", n, alive);
+    }
+    unsigned long int frontier = prune(points, count, 0.0, 0);
+    printf("full-trace evaluations:\t\t%lu (frontier of %lu)\n", alive, frontier);
+
+    char buf[64];
+    tune_point **best = (tune_point**)malloc(count * sizeof(tune_point*));
+    unsigned long int num_best = 0;
+    printf("PARETO FRONTIER\n");
+    printf("bits\tconfiguration\tmispredictions\tmisprediction rate\n");
+    for(unsigned long int i = 0; i < count; i++) {
+        if(!points[i].alive) continue;
+        best[num_best++] = &points[i];
+        format_config(buf, &points[i].params);
+        printf("%lu\t%s\t%lu\t%.2f%%\n", points[i].bits, buf, points[i].mispredictions,
+               (double)points[i].mispredictions / len * 100);
+    }
+
+    qsort(best, num_best, sizeof(best[0]), by_mispredictions);
+    if(top > num_best) top = num_best;
+    printf("BEST CONFIGURATIONS\n");
+    printf("rank\tbits\tconfiguration\tmispredictions\tmisprediction rate\n");
+    for(unsigned long int i = 0; i < top; i++) {
+        format_config(buf, &best[i]->params);
+        printf("%lu\t%lu\t%s\t%lu\t%.2f%%\n", i + 1, best[i]->bits, buf, best[i]->mispredictions,
+               (double)best[i]->mispredictions / len * 100);
+    }
+
+    free(best);
+    free(points);
+    free(decoded);
+    return 0;
+}
@@ -0,0 +1,17 @@
+#ifndef BP_TUNE_H
+#define BP_TUNE_H
+
+// sim tune <budget bits> <tracefile> [--prefix=N] [--slack=PCT] [--top=N]
+//
+// Enumerates every bimodal, gshare and hybrid configuration whose storage
+// fits the budget (2 bits per counter plus N global history bits), evaluates
+// them all on a prefix of the trace, drops points that a point of no greater
+// cost beats by more than two standard deviations of sampling noise (plus
+// --slack percent, default 0), and repeats on 8x longer prefixes until the
+// survivors are evaluated on the whole trace.  The Pareto frontier of those
+// full-trace results (each point strictly better than every cheaper one) and
+// the best configurations are reported, along with how many full-trace
+// evaluations it took.
+int run_tune(int argc, char* argv[]);
+
+#endif
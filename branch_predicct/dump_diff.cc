@@ -0,0 +1,64 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bp_dump.h"
+
+// dump_diff [-q] <a.bin> <b.bin>
+// Compares two binary FINAL CONTENTS dumps (sim --dump-bin=FILE) table by
+// table.  Lists differing entries unless -q is given; exits 0 when the dumps
+// are identical, 1 when they differ and 2 on error.
+
+int main (int argc, char* argv[])
+{
+    int quiet = 0;
+    if(argc == 4 && strcmp(argv[1], "-q") == 0) {
+        quiet = 1;
+        argv++;
+        argc--;
+    }
+    if(argc != 3)
+    {
+        printf("Usage: %s [-q] <a.bin> <b.bin>\n", argv[0]);
+        return 2;
+    }
+
+    bp_dump a, b;
+    if(bp_dump_read(argv[1], &a) != 0)
+    {
+        printf("Error: Unable to read dump %s\n", argv[1]);
+        return 2;
+    }
+    if(bp_dump_read(argv[2], &b) != 0)
+    {
+        printf("Error: Unable to read dump %s\n", argv[2]);
+        return 2;
+    }
+
+    int differ = 0;
+    if(a.count != b.count) {
+        printf("table count differs: %u vs %u\n", a.count, b.count);
+        differ = 1;
+    }
+
+    unsigned int tables = (a.count < b.count) ? a.count : b.count;
+    for(unsigned int t = 0; t < tables; t++) {
+        bp_dump_table *x = &a.tables[t], *y = &b.tables[t];
+        if(strcmp(x->name, y->name) != 0 || x->bits != y->bits) {
+            printf("table %u differs in shape: %s[%u bits] vs %s[%u bits]\n", t, x->name, x->bits, y->name, y->bits);
+            differ = 1;
+            continue;
+        }
+        unsigned long int size = 1UL << x->bits, mismatches = 0;
+        for(unsigned long int i = 0; i < size; i++) {
+            if(x->counters[i] == y->counters[i]) continue;
+            if(!quiet) printf("%s\t%lu\t%d\t%d\n", x->name, i, x->counters[i], y->counters[i]);
+            mismatches++;
+        }
+        printf("%s: %lu of %lu entries differ\n", x->name, mismatches, size);
+        if(mismatches) differ = 1;
+    }
+
+    bp_dump_free(&a);
+    bp_dump_free(&b);
+    return differ;
+}
@@ -2,15 +2,316 @@
 #include <stdlib.h>
 #include <string.h>
 #include "sim_bp.h"
+#include "bp_predictor.h"
+#include "bp_batch.h"
+#include "bp_trace.h"
+#include "bp_profile.h"
+#include "bp_dump.h"
+#include "bp_tune.h"
 
-int main (int argc, char* argv[])
+// Parses "a,b,c" and "lo-hi" (or a mix, e.g. "0-4,8,12") into values[];
+// returns the number of values, or -1 on malformed input.
+static int parse_list(const char *arg, unsigned long int *values, int max_values)
 {
-    FILE *FP;
+    int n = 0;
+    const char *p = arg;
+    while(*p) {
+        char *end;
+        unsigned long int lo = strtoul(p, &end, 10);
+        if(end == p) return -1;
+        unsigned long int hi = lo;
+        if(*end == '-') {
+            p = end + 1;
+            hi = strtoul(p, &end, 10);
+            if(end == p || hi < lo) return -1;
+        }
+        for(unsigned long int v = lo; v <= hi; v++) {
+            if(n == max_values) return -1;
+            values[n++] = v;
+        }
+        if(*end == ',') end++;
+        else if(*end != '\0') return -1;
+        p = end;
+    }
+    return n;
+}
+
+// sim sweep bimodal <M2 list> <tracefile>
+// sim sweep gshare <M1 list> <N list> <tracefile>
+static int run_sweep(int argc, char* argv[])
+{
+    unsigned long int m_list[64], n_list[64];
+    int num_m, num_n = 1;
     char *trace_file;
-    bp_params params;
-    char outcome;
+    char *bp_name = argv[2];
+
+    n_list[0] = 0;
+    if(argc == 5 && strcmp(bp_name, "bimodal") == 0) {
+        num_m      = parse_list(argv[3], m_list, 64);
+        trace_file = argv[4];
+        printf("COMMAND\n%s sweep %s %s %s\n", argv[0], bp_name, argv[3], trace_file);
+    } else if(argc == 6 && strcmp(bp_name, "gshare") == 0) {
+        num_m      = parse_list(argv[3], m_list, 64);
+        num_n      = parse_list(argv[4], n_list, 64);
+        trace_file = argv[5];
+        printf("COMMAND\n%s sweep %s %s %s %s\n", argv[0], bp_name, argv[3], argv[4], trace_file);
+    } else {
+        printf("Error: sweep wrong inputs (sweep bimodal <M2 list> <tracefile> | sweep gshare <M1 list> <N list> <tracefile>)\n");
+        exit(EXIT_FAILURE);
+    }
+    if(num_m <= 0 || num_n <= 0) {
+        printf("Error: malformed sweep list\n");
+        exit(EXIT_FAILURE);
+    }
+
+    bp_params *configs = (bp_params*)malloc(num_m * num_n * sizeof(bp_params));
+    unsigned int count = 0;
+    for(int i = 0; i < num_m; i++) {
+        if(m_list[i] > 30) {
+            printf("Error: sweep table index bits must be <= 30\n");
+            exit(EXIT_FAILURE);
+        }
+        for(int j = 0; j < num_n; j++) {
+            if(n_list[j] > m_list[i]) continue;
+            bp_params *c = &configs[count++];
+            c->bp_name = bp_name;
+            c->K = 0;
+            c->M1 = m_list[i];
+            c->M2 = m_list[i];
+            c->N = n_list[j];
+        }
+    }
+    if(count == 0) {
+        printf("Error: no valid sweep configuration (N must be <= M1)\n");
+        exit(EXIT_FAILURE);
+    }
+
+    bp_trace trace;
+    if(bp_trace_open(&trace, trace_file) != 0)
+    {
+        printf("Error: Unable to open file %s\n", trace_file);
+        exit(EXIT_FAILURE);
+    }
+
+    bp_batch batch;
+    if(bp_batch_init(&batch, configs, count) != 0)
+    {
+        printf("Error: sweep %s\n", batch.error);
+        exit(EXIT_FAILURE);
+    }
+
     unsigned long int addr;
+    int taken, r;
+    while((r = bp_trace_next(&trace, &addr, &taken)) > 0)
+        bp_batch_step(&batch, addr, taken);
+    if(r < 0)
+    {
+        char where[64];
+        printf("Error: %s at %s of %s\n", trace.error, bp_trace_where(&trace, where, sizeof(where)), trace_file);
+        exit(EXIT_FAILURE);
+    }
+    bp_batch_finish(&batch);
+
+    printf("OUTPUT\n");
+    printf("number of predictions:\t\t%lu\n", batch.predictions);
+    printf("configuration\tmispredictions\tmisprediction rate\n");
+    for(unsigned int i = 0; i < count; i++) {
+        if(strcmp(bp_name, "bimodal") == 0)
+            printf("bimodal %lu\t", configs[i].M2);
+        else
+            printf("gshare %lu %lu\t", configs[i].M1, configs[i].N);
+        printf("%lu\t%.2f%%\n", batch.mispredictions[i], (double)batch.mispredictions[i] / batch.predictions * 100);
+    }
+
+    bp_batch_free(&batch);
+    free(configs);
+    bp_trace_close(&trace);
+    return 0;
+}
+
+typedef struct bp_extra_stats{
+    unsigned long int loop_hits;           // confident loop predictions
+    unsigned long int loop_overrides;      // ... that differed from the prediction below
+    unsigned long int loop_overrides_correct;
+    unsigned long int sc_hits;             // lookups where the corrector disagreed
+    unsigned long int sc_overrides;        // ... confidently enough to invert
+    unsigned long int sc_overrides_correct;
+    unsigned long int btb_lookups;
+    unsigned long int btb_hits;
+    unsigned long int btb_misses;          // taken branches not in the BTB
+    unsigned long int btb_mispredictions;  // BTB hits with a stale target
+    unsigned long int ras_returns;
+    unsigned long int ras_mispredictions;
+}bp_extra_stats;
+
+// Target prediction for one branch record.  Every branch looks up the BTB;
+// returns are predicted by the RAS when there is one, and calls push their
+// fall-through address.  Only taken branches are installed in the BTB.
+static void predict_target(BranchTargetBuffer *btb, ReturnAddressStack *ras, const bp_record &rec, bp_extra_stats *es)
+{
+    int from_ras = (ras != NULL && rec.type == BR_RETURN);
+    if(from_ras) {
+        es->ras_returns++;
+        if(ras->pop() != rec.target) es->ras_mispredictions++;
+    }
+    if(btb) {
+        unsigned long int target;
+        int type, hit;
+        es->btb_lookups++;
+        hit = btb->lookup(rec.pc, &target, &type);
+        es->btb_hits += hit;
+        if(rec.taken && !from_ras) {
+            if(!hit) es->btb_misses++;
+            else if(target != rec.target) es->btb_mispredictions++;
+        }
+        if(rec.taken) btb->update(rec.pc, rec.target, rec.type);
+    }
+    if(ras != NULL && rec.type == BR_CALL) ras->push(rec.pc + 4);
+}
+
+// Loop predictor and statistical corrector on top of the direction
+// predictor: the corrector may invert the prediction, then a confident loop
+// entry overrides the result.
+static int refine_prediction(LoopPredictor *loop, StatisticalCorrector *sc, unsigned long int pc,
+                             const bp_lookup &l, int taken, bp_extra_stats *es)
+{
+    int prediction = l.prediction;
+    if(sc) {
+        sc_lookup s;
+        prediction = sc->predict(pc, l.counter, &s);
+        if((s.sum >= 0) != s.base_prediction) es->sc_hits++;
+        if(prediction != s.base_prediction) {
+            es->sc_overrides++;
+            es->sc_overrides_correct += (prediction == taken);
+        }
+        sc->update(s, taken);
+    }
+    if(loop) {
+        loop_lookup ll;
+        if(loop->predict(pc, &ll)) {
+            es->loop_hits++;
+            if(ll.prediction != prediction) {
+                es->loop_overrides++;
+                es->loop_overrides_correct += (ll.prediction == taken);
+            }
+        }
+        loop->update(pc, ll, taken, prediction == taken);
+        if(ll.confident) prediction = ll.prediction;
+    }
+    return prediction;
+}
+
+// The hot loop is instantiated with and without profiling so that a run
+// without --profile pays nothing for it.  Only conditional branches reach the
+// direction predictor.
+template<bool PROFILE>
+static int simulate(BranchPredictor &bp, LoopPredictor *loop, StatisticalCorrector *sc,
+                    BranchTargetBuffer *btb, ReturnAddressStack *ras, bp_trace *trace,
+                    bp_profile *prof, bp_extra_stats *es, unsigned int *predictions, unsigned int *mispredictions)
+{
+    unsigned int num_predictions = 0;
+    unsigned int num_mispredictions = 0;
+    int hybrid = (bp.type == BP_HYBRID);
+    int targets = (btb != NULL || ras != NULL);
+    int addons = (loop != NULL || sc != NULL);
     
+    bp_record rec;
+    int r;
+    while((r = bp_trace_read(trace, &rec)) > 0)
+    {
+        if(targets) predict_target(btb, ras, rec, es);
+        if(rec.type != BR_COND) continue;
+        
+        bp_lookup l;
+        int prediction = bp.predict(rec.pc, &l);
+        if(addons) prediction = refine_prediction(loop, sc, rec.pc, l, rec.taken, es);
+        bp.update(l, rec.taken);
+        bp.update_history(rec.taken);
+        
+        num_predictions++;
+        if(prediction != rec.taken) num_mispredictions++;
+        
+        if(PROFILE) {
+            bp_profile_entry *e = bp_profile_record(prof, rec.pc, rec.taken, prediction);
+            if(hybrid)
+                bp_profile_record_chooser(prof, e, l.use_gshare, l.gshare_pred, l.bimodal_pred, rec.taken);
+        }
+    }
+    
+    *predictions = num_predictions;
+    *mispredictions = num_mispredictions;
+    return r;
+}
+
+int main (int argc, char* argv[])
+{
+    bp_trace trace;
+    char *trace_file;
+    bp_params params;
+    unsigned long int profile_top = 0;
+    enum { DUMP_TEXT, DUMP_NONE, DUMP_BINARY } dump_mode = DUMP_TEXT;
+    const char *dump_file = NULL;
+    unsigned long int btb_entries = 0, btb_ways = 4, ras_depth = 0;
+    unsigned long int loop_entries = 0, sc_bits = 0;
+
+    if(argc >= 2 && strcmp(argv[1], "sweep") == 0)
+        return run_sweep(argc, argv);
+    if(argc >= 2 && strcmp(argv[1], "tune") == 0)
+        return run_tune(argc, argv);
+
+    // options ("--name[=value]") may appear anywhere; they are removed before
+    // the positional arguments are counted
+    int nargs = 1;
+    for(int i = 1; i < argc; i++) {
+        if(strncmp(argv[i], "--", 2) != 0) {
+            argv[nargs++] = argv[i];
+        } else if(strcmp(argv[i], "--profile") == 0) {
+            profile_top = 20;
+        } else if(strncmp(argv[i], "--profile=", 10) == 0) {
+            profile_top = strtoul(argv[i] + 10, NULL, 10);
+            if(profile_top == 0) profile_top = 20;
+        } else if(strcmp(argv[i], "--no-dump") == 0) {
+            dump_mode = DUMP_NONE;
+        } else if(strncmp(argv[i], "--dump-bin=", 11) == 0 && argv[i][11] != '\0') {
+            dump_mode = DUMP_BINARY;
+            dump_file = argv[i] + 11;
+        } else if(strncmp(argv[i], "--btb=", 6) == 0) {
+            char *end;
+            btb_entries = strtoul(argv[i] + 6, &end, 10);
+            if(*end == ',') btb_ways = strtoul(end + 1, &end, 10);
+            if(*end != '\0' || btb_entries == 0 || btb_ways == 0 || btb_ways > btb_entries ||
+               (btb_entries & (btb_entries - 1)) || (btb_ways & (btb_ways - 1))) {
+                printf("Error: --btb needs power-of-two ENTRIES[,WAYS] with WAYS <= ENTRIES\n");
+                exit(EXIT_FAILURE);
+            }
+        } else if(strcmp(argv[i], "--loop") == 0 || strncmp(argv[i], "--loop=", 7) == 0) {
+            char *end = (char*)"";
+            loop_entries = argv[i][6] ? strtoul(argv[i] + 7, &end, 10) : 64;
+            if(*end != '\0' || loop_entries < LOOP_WAYS || (loop_entries & (loop_entries - 1))) {
+                printf("Error: --loop needs a power-of-two ENTRIES >= %d\n", LOOP_WAYS);
+                exit(EXIT_FAILURE);
+            }
+        } else if(strcmp(argv[i], "--sc") == 0 || strncmp(argv[i], "--sc=", 5) == 0) {
+            char *end = (char*)"";
+            sc_bits = argv[i][4] ? strtoul(argv[i] + 5, &end, 10) : 10;
+            if(*end != '\0' || sc_bits < 4 || sc_bits > 24) {
+                printf("Error: --sc needs index BITS between 4 and 24\n");
+                exit(EXIT_FAILURE);
+            }
+        } else if(strncmp(argv[i], "--ras=", 6) == 0) {
+            char *end;
+            ras_depth = strtoul(argv[i] + 6, &end, 10);
+            if(*end != '\0' || ras_depth == 0) {
+                printf("Error: --ras needs a positive DEPTH\n");
+                exit(EXIT_FAILURE);
+            }
+        } else {
+            printf("Error: Unknown option %s\n", argv[i]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    argc = nargs;
+
     if (!(argc == 4 || argc == 5 || argc == 7))
     {
         printf("Error: Wrong number of inputs:%d\n", argc-1);
@@ -64,170 +365,103 @@ int main (int argc, char* argv[])
         exit(EXIT_FAILURE);
     }
     
-    FP = fopen(trace_file, "r");
-    if(FP == NULL)
+    if(bp_trace_open(&trace, trace_file) != 0)
     {
         printf("Error: Unable to open file %s\n", trace_file);
         exit(EXIT_FAILURE);
     }
     
-    unsigned int *bimodal_table = NULL;
-    unsigned int *gshare_table = NULL;
-    unsigned int *chooser_table = NULL;
-    unsigned int ghr = 0;
-    unsigned int predictions = 0;
-    unsigned int mispredictions = 0;
+    BranchPredictor bp(params);
+    BranchTargetBuffer *btb = btb_entries ? new BranchTargetBuffer(btb_entries, btb_ways) : NULL;
+    ReturnAddressStack *ras = ras_depth ? new ReturnAddressStack(ras_depth) : NULL;
+    LoopPredictor *loop = loop_entries ? new LoopPredictor(loop_entries) : NULL;
+    StatisticalCorrector *sc = sc_bits ? new StatisticalCorrector(sc_bits) : NULL;
+    bp_extra_stats es;
+    memset(&es, 0, sizeof(es));
+    unsigned int predictions, mispredictions;
     
-    if(strcmp(params.bp_name, "bimodal") == 0) {
-        unsigned int size = 1 << params.M2;
-        bimodal_table = (unsigned int*)malloc(size * sizeof(unsigned int));
-        for(unsigned int i = 0; i < size; i++) bimodal_table[i] = 2;
-    } else if(strcmp(params.bp_name, "gshare") == 0) {
-        unsigned int size = 1 << params.M1;
-        gshare_table = (unsigned int*)malloc(size * sizeof(unsigned int));
-        for(unsigned int i = 0; i < size; i++) gshare_table[i] = 2;
-    } else if(strcmp(params.bp_name, "hybrid") == 0) {
-        unsigned int size_chooser = 1 << params.K;
-        unsigned int size_gshare = 1 << params.M1;
-        unsigned int size_bimodal = 1 << params.M2;
-        chooser_table = (unsigned int*)malloc(size_chooser * sizeof(unsigned int));
-        gshare_table = (unsigned int*)malloc(size_gshare * sizeof(unsigned int));
-        bimodal_table = (unsigned int*)malloc(size_bimodal * sizeof(unsigned int));
-        for(unsigned int i = 0; i < size_chooser; i++) chooser_table[i] = 1;
-        for(unsigned int i = 0; i < size_gshare; i++) gshare_table[i] = 2;
-        for(unsigned int i = 0; i < size_bimodal; i++) bimodal_table[i] = 2;
+    bp_profile prof;
+    int r;
+    if(profile_top) {
+        bp_profile_init(&prof);
+        r = simulate<true>(bp, loop, sc, btb, ras, &trace, &prof, &es, &predictions, &mispredictions);
+    } else {
+        r = simulate<false>(bp, loop, sc, btb, ras, &trace, NULL, &es, &predictions, &mispredictions);
     }
     
-    char str[2];
-    while(fscanf(FP, "%lx %s", &addr, str) != EOF)
+    if(r < 0)
     {
-        outcome = str[0];
-        int taken = (outcome == 't') ? 1 : 0;
-        int prediction = 0;
-        
-        if(strcmp(params.bp_name, "bimodal") == 0) {
-            unsigned int idx = (addr >> 2) & ((1 << params.M2) - 1);
-            prediction = (bimodal_table[idx] >= 2) ? 1 : 0;
-            if(taken) {
-                if(bimodal_table[idx] < 3) bimodal_table[idx]++;
-            } else {
-                if(bimodal_table[idx] > 0) bimodal_table[idx]--;
-            }
-        } else if(strcmp(params.bp_name, "gshare") == 0) {
-            if(params.N == 0) {
-                unsigned int idx = (addr >> 2) & ((1 << params.M1) - 1);
-                prediction = (gshare_table[idx] >= 2) ? 1 : 0;
-                if(taken) {
-                    if(gshare_table[idx] < 3) gshare_table[idx]++;
-                } else {
-                    if(gshare_table[idx] > 0) gshare_table[idx]--;
-                }
-            } else {
-                unsigned int pc_bits = (addr >> 2) & ((1 << params.M1) - 1);
-                unsigned int pc_upper = pc_bits >> (params.M1 - params.N);
-                unsigned int pc_lower = pc_bits & ((1 << (params.M1 - params.N)) - 1);
-                unsigned int idx = ((pc_upper ^ ghr) << (params.M1 - params.N)) | pc_lower;
-                prediction = (gshare_table[idx] >= 2) ? 1 : 0;
-                if(taken) {
-                    if(gshare_table[idx] < 3) gshare_table[idx]++;
-                } else {
-                    if(gshare_table[idx] > 0) gshare_table[idx]--;
-                }
-                ghr = ((ghr >> 1) | ((taken ? 1 : 0) << (params.N - 1))) & ((1 << params.N) - 1);
-            }
-        } else if(strcmp(params.bp_name, "hybrid") == 0) {
-            int gshare_pred;
-            unsigned int idx_gshare;
-            
-            if(params.N == 0) {
-                idx_gshare = (addr >> 2) & ((1 << params.M1) - 1);
-                gshare_pred = (gshare_table[idx_gshare] >= 2) ? 1 : 0;
-            } else {
-                unsigned int pc_bits_gshare = (addr >> 2) & ((1 << params.M1) - 1);
-                unsigned int pc_upper = pc_bits_gshare >> (params.M1 - params.N);
-                unsigned int pc_lower = pc_bits_gshare & ((1 << (params.M1 - params.N)) - 1);
-                idx_gshare = ((pc_upper ^ ghr) << (params.M1 - params.N)) | pc_lower;
-                gshare_pred = (gshare_table[idx_gshare] >= 2) ? 1 : 0;
-            }
-            
-            unsigned int idx_bimodal = (addr >> 2) & ((1 << params.M2) - 1);
-            int bimodal_pred = (bimodal_table[idx_bimodal] >= 2) ? 1 : 0;
-            
-            unsigned int idx_chooser = (addr >> 2) & ((1 << params.K) - 1);
-            prediction = (chooser_table[idx_chooser] >= 2) ? gshare_pred : bimodal_pred;
-            
-            if(chooser_table[idx_chooser] >= 2) {
-                if(taken) {
-                    if(gshare_table[idx_gshare] < 3) gshare_table[idx_gshare]++;
-                } else {
-                    if(gshare_table[idx_gshare] > 0) gshare_table[idx_gshare]--;
-                }
-            } else {
-                if(taken) {
-                    if(bimodal_table[idx_bimodal] < 3) bimodal_table[idx_bimodal]++;
-                } else {
-                    if(bimodal_table[idx_bimodal] > 0) bimodal_table[idx_bimodal]--;
-                }
-            }
-            
-            if(params.N > 0) {
-                ghr = ((ghr >> 1) | ((taken ? 1 : 0) << (params.N - 1))) & ((1 << params.N) - 1);
-            }
-            
-            int gshare_correct = (gshare_pred == taken);
-            int bimodal_correct = (bimodal_pred == taken);
-            
-            if(gshare_correct && !bimodal_correct) {
-                if(chooser_table[idx_chooser] < 3) chooser_table[idx_chooser]++;
-            } else if(!gshare_correct && bimodal_correct) {
-                if(chooser_table[idx_chooser] > 0) chooser_table[idx_chooser]--;
-            }
-        }
-        
-        predictions++;
-        if(prediction != taken) mispredictions++;
+        char where[64];
+        printf("Error: %s at %s of %s\n", trace.error, bp_trace_where(&trace, where, sizeof(where)), trace_file);
+        exit(EXIT_FAILURE);
     }
     
     printf("OUTPUT\n");
     printf("number of predictions:\t\t%u\n", predictions);
     printf("number of mispredictions:\t%u\n", mispredictions);
     printf("misprediction rate:\t\t%.2f%%\n", (double)mispredictions / predictions * 100);
+    if(loop) {
+        printf("loop predictor hits:\t\t%lu\n", es.loop_hits);
+        printf("loop predictor overrides:\t%lu\n", es.loop_overrides);
+        printf("loop overrides correct:\t\t%lu\n", es.loop_overrides_correct);
+    }
+    if(sc) {
+        printf("SC hits:\t\t\t%lu\n", es.sc_hits);
+        printf("SC overrides:\t\t\t%lu\n", es.sc_overrides);
+        printf("SC overrides correct:\t\t%lu\n", es.sc_overrides_correct);
+    }
+    if(btb) {
+        printf("BTB lookups:\t\t\t%lu\n", es.btb_lookups);
+        printf("BTB hits:\t\t\t%lu\n", es.btb_hits);
+        printf("BTB misses (taken):\t\t%lu\n", es.btb_misses);
+        printf("BTB target mispredictions:\t%lu\n", es.btb_mispredictions);
+    }
+    if(ras) {
+        printf("RAS returns:\t\t\t%lu\n", es.ras_returns);
+        printf("RAS mispredictions:\t\t%lu\n", es.ras_mispredictions);
+    }
     
-    if(strcmp(params.bp_name, "bimodal") == 0) {
-        printf("FINAL BIMODAL CONTENTS\n");
-        unsigned int size = 1 << params.M2;
-        for(unsigned int i = 0; i < size; i++) {
-            printf("%d\t%d\n", i, bimodal_table[i]);
-        }
-        free(bimodal_table);
-    } else if(strcmp(params.bp_name, "gshare") == 0) {
-        printf("FINAL GSHARE CONTENTS\n");
-        unsigned int size = 1 << params.M1;
-        for(unsigned int i = 0; i < size; i++) {
-            printf("%d\t%d\n", i, gshare_table[i]);
-        }
-        free(gshare_table);
-    } else if(strcmp(params.bp_name, "hybrid") == 0) {
-        printf("FINAL CHOOSER CONTENTS\n");
-        unsigned int size = 1 << params.K;
-        for(unsigned int i = 0; i < size; i++) {
-            printf("%d\t%d\n", i, chooser_table[i]);
+    if(dump_mode == DUMP_TEXT) {
+        if(bp.type == BP_BIMODAL) {
+            bp_dump_text(stdout, "BIMODAL", bp.bimodal_table, 1UL << params.M2);
+        } else if(bp.type == BP_GSHARE) {
+            bp_dump_text(stdout, "GSHARE", bp.gshare_table, 1UL << params.M1);
+        } else {
+            bp_dump_text(stdout, "CHOOSER", bp.chooser_table, 1UL << params.K);
+            bp_dump_text(stdout, "GSHARE", bp.gshare_table, 1UL << params.M1);
+            bp_dump_text(stdout, "BIMODAL", bp.bimodal_table, 1UL << params.M2);
         }
-        printf("FINAL GSHARE CONTENTS\n");
-        size = 1 << params.M1;
-        for(unsigned int i = 0; i < size; i++) {
-            printf("%d\t%d\n", i, gshare_table[i]);
+    } else if(dump_mode == DUMP_BINARY) {
+        FILE *out = bp_dump_begin(dump_file, (bp.type == BP_HYBRID) ? 3 : 1);
+        int err = (out == NULL);
+        if(!err) {
+            if(bp.type == BP_BIMODAL) {
+                err |= bp_dump_add(out, "BIMODAL", bp.bimodal_table, params.M2);
+            } else if(bp.type == BP_GSHARE) {
+                err |= bp_dump_add(out, "GSHARE", bp.gshare_table, params.M1);
+            } else {
+                err |= bp_dump_add(out, "CHOOSER", bp.chooser_table, params.K);
+                err |= bp_dump_add(out, "GSHARE", bp.gshare_table, params.M1);
+                err |= bp_dump_add(out, "BIMODAL", bp.bimodal_table, params.M2);
+            }
+            err |= bp_dump_end(out);
         }
-        printf("FINAL BIMODAL CONTENTS\n");
-        size = 1 << params.M2;
-        for(unsigned int i = 0; i < size; i++) {
-            printf("%d\t%d\n", i, bimodal_table[i]);
+        if(err)
+        {
+            printf("Error: Unable to write dump %s\n", dump_file);
+            exit(EXIT_FAILURE);
         }
-        free(chooser_table);
-        free(gshare_table);
-        free(bimodal_table);
+    }
+    delete btb;
+    delete ras;
+    delete loop;
+    delete sc;
+    
+    if(profile_top) {
+        bp_profile_report(&prof, profile_top, bp.type == BP_HYBRID);
+        bp_profile_free(&prof);
     }
     
-    fclose(FP);
+    bp_trace_close(&trace);
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,70 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bp_trace.h"
+
+// trace_conv <in> <out>      convert a trace (either format) to binary
+// trace_conv -t <in> <out>   convert a trace (either format) to text
+//
+// Traces whose records carry targets and branch types are written in the
+// extended form of the output format.
+
+int main (int argc, char* argv[])
+{
+    int to_text = 0;
+    if(argc == 4 && strcmp(argv[1], "-t") == 0) {
+        to_text = 1;
+        argv++;
+        argc--;
+    }
+    if(argc != 3)
+    {
+        printf("Usage: %s [-t] <input trace> <output trace>\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    bp_trace trace;
+    if(bp_trace_open(&trace, argv[1]) != 0)
+    {
+        printf("Error: Unable to open file %s\n", argv[1]);
+        exit(EXIT_FAILURE);
+    }
+
+    bp_record rec;
+    int r, extended = trace.extended;
+    if(!trace.binary) {
+        // a text trace is extended if any record has a target and type
+        while((r = bp_trace_read(&trace, &rec)) > 0 && !extended)
+            extended = (rec.target != 0 || rec.type != 0);
+        bp_trace_rewind(&trace);
+    }
+
+    static bp_trace_writer w;
+    if(bp_trace_create(&w, argv[2], !to_text, extended) != 0)
+    {
+        printf("Error: Unable to open file %s\n", argv[2]);
+        exit(EXIT_FAILURE);
+    }
+
+    while((r = bp_trace_read(&trace, &rec)) > 0)
+        if(bp_trace_write(&w, &rec) != 0)
+        {
+            printf("Error: record %lu of %s jumps too far to encode (pc %lx)\n", (unsigned long int)w.count, argv[1], rec.pc);
+            exit(EXIT_FAILURE);
+        }
+    if(r < 0)
+    {
+        char where[64];
+        printf("Error: %s at %s of %s\n", trace.error, bp_trace_where(&trace, where, sizeof(where)), argv[1]);
+        exit(EXIT_FAILURE);
+    }
+    if(bp_trace_finish(&w) != 0)
+    {
+        printf("Error: Unable to write file %s\n", argv[2]);
+        exit(EXIT_FAILURE);
+    }
+
+    bp_trace_close(&trace);
+    printf("%lu branches written to %s\n", (unsigned long int)w.count, argv[2]);
+    return 0;
+}
@@ -0,0 +1,49 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bp_gen.h"
+
+// trace_gen [-b] <pattern> <branches> <static branches> <seed> <out>
+//
+// Writes a synthetic branch trace (text, or binary with -b); see bp_gen.h
+// for the patterns.
+
+int main (int argc, char* argv[])
+{
+    int binary = 0;
+    if(argc == 7 && strcmp(argv[1], "-b") == 0) {
+        binary = 1;
+        argv++;
+        argc--;
+    }
+    if(argc != 6)
+    {
+        printf("Usage: %s [-b] <pattern> <branches> <static branches> <seed> <output trace>\n", argv[0]);
+        printf("patterns:");
+        for(int p = 0; p < BP_GEN_PATTERNS; p++) printf(" %s", bp_gen_names[p]);
+        printf("\n");
+        exit(EXIT_FAILURE);
+    }
+
+    int pattern = bp_gen_pattern(argv[1]);
+    unsigned long int num_branches = strtoul(argv[2], NULL, 10);
+    unsigned long int num_static = strtoul(argv[3], NULL, 10);
+    uint64_t seed = strtoull(argv[4], NULL, 10);
+    if(pattern < 0)
+    {
+        printf("Error: Unknown pattern %s\n", argv[1]);
+        exit(EXIT_FAILURE);
+    }
+    if(num_static == 0)
+    {
+        printf("Error: static branch count must be positive\n");
+        exit(EXIT_FAILURE);
+    }
+    if(bp_gen_write(argv[5], pattern, num_branches, num_static, seed, binary) != 0)
+    {
+        printf("Error: Unable to write file %s\n", argv[5]);
+        exit(EXIT_FAILURE);
+    }
+    printf("%lu branches written to %s\n", num_branches, argv[5]);
+    return 0;
+}